@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+
+#include "cache.hpp"
+#include "fake.hpp"
+#include "macros/unwrap.hpp"
+#include "request.hpp"
+#include "stats.hpp"
+#include "util/charconv.hpp"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Args {
+    v4l2::FakeConfig config;
+    int              iterations = 200;
+};
+
+auto print_usage() -> void {
+    printf("usage: v4l2-wlctl-benchmark [OPTION]...\n");
+    printf("  --controls N    controls per class\n");
+    printf("  --classes N     number of control classes\n");
+    printf("  --menu-size N   menu range of menu controls\n");
+    printf("  --menu-stride N only every N-th menu index is valid\n");
+    printf("  --latency US    simulated latency of each ioctl\n");
+    printf("  --legacy        no extended control ioctls\n");
+    printf("  --iterations N\n");
+}
+
+auto parse_args(const int argc, const char* argv[]) -> std::optional<Args> {
+    constexpr auto all_classes = std::array{
+        V4L2_CTRL_CLASS_USER,
+        V4L2_CTRL_CLASS_CODEC,
+        V4L2_CTRL_CLASS_CAMERA,
+        V4L2_CTRL_CLASS_FLASH,
+        V4L2_CTRL_CLASS_JPEG,
+        V4L2_CTRL_CLASS_IMAGE_SOURCE,
+        V4L2_CTRL_CLASS_IMAGE_PROC,
+        V4L2_CTRL_CLASS_DETECT,
+    };
+
+    auto ret = Args();
+    for(auto i = 1; i < argc; i += 1) {
+        const auto opt = std::string_view(argv[i]);
+        if(opt == "--legacy") {
+            ret.config.legacy = true;
+            continue;
+        }
+        ensure(i + 1 < argc);
+        unwrap(num, from_chars<uint32_t>(argv[i += 1]));
+        if(opt == "--controls") {
+            ret.config.controls_per_class = num;
+        } else if(opt == "--classes") {
+            ensure(num >= 1 && num <= all_classes.size());
+            ret.config.classes.assign(all_classes.begin(), all_classes.begin() + num);
+        } else if(opt == "--menu-size") {
+            ret.config.menu_size = num;
+        } else if(opt == "--menu-stride") {
+            ret.config.menu_stride = num;
+        } else if(opt == "--latency") {
+            ret.config.latency = std::chrono::microseconds(num);
+        } else if(opt == "--iterations") {
+            ensure(num >= 1);
+            ret.iterations = num;
+        } else {
+            bail("unknown option");
+        }
+    }
+    return ret;
+}
+
+// runs func for iterations times and prints latency percentiles
+auto measure(const char* const name, const int iterations, const std::function<void()> func) -> void {
+    auto samples = std::vector<double>(iterations);
+    for(auto& sample : samples) {
+        const auto begin = Clock::now();
+        func();
+        sample = std::chrono::duration<double, std::micro>(Clock::now() - begin).count();
+    }
+    std::ranges::sort(samples);
+    const auto at = [&samples](const double p) { return samples[std::min(samples.size() - 1, size_t(samples.size() * p))]; };
+    auto       sum = 0.0;
+    for(const auto sample : samples) {
+        sum += sample;
+    }
+    printf("%-16s %10.0f ops/s  p50 %9.1fus  p90 %9.1fus  p99 %9.1fus  max %9.1fus\n",
+           name, iterations / (sum / 1e6), at(0.5), at(0.9), at(0.99), samples.back());
+}
+
+auto count_calls(const char* const name) -> uint64_t {
+    for(const auto& stats : v4l2::get_ioctl_stats()) {
+        if(std::string_view(stats.name) == name) {
+            return stats.calls;
+        }
+    }
+    return 0;
+}
+
+// startup of the window with every menu shown, returns the number of menu queries
+auto start_cached(const int fd) -> uint64_t {
+    const auto before = count_calls("VIDIOC_QUERYMENU");
+    auto       table  = v4l2::ControlTable();
+    table.assign(fd, v4l2::query_controls_cached(fd));
+    for(auto i = 0u; i < table.size(); i += 1) {
+        if(v4l2::is_menu(table.types[i])) {
+            table.get_menu_size(i);
+        }
+    }
+    const auto queried = count_calls("VIDIOC_QUERYMENU") - before;
+    v4l2::save_menu_cache(fd, table);
+    return queried;
+}
+
+auto run(const int argc, const char* argv[]) -> bool {
+    const auto args = parse_args(argc, argv);
+    if(!args) {
+        print_usage();
+        return false;
+    }
+
+    auto backend = v4l2::FakeBackend(args->config);
+    v4l2::set_backend(&backend);
+    const auto fd = v4l2::open_device("fake");
+    ensure(fd >= 0);
+
+    // expected cost of one enumeration, fail if it regresses
+    // one query per control including class controls plus the terminating one, one query per menu index when eager,
+    // and one bulk read per class, or one read per control on legacy drivers
+    // compound controls are only enumerated by the extended query, and never read in bulk
+    const auto& config     = args->config;
+    const auto  classes    = config.classes.size();
+    const auto  compounds  = config.compound && !config.legacy ? classes : 0;
+    const auto  ctrls      = classes * config.controls_per_class + compounds;
+    const auto  menu_ctrls = classes * (config.controls_per_class / 3);
+    const auto  enumerate  = ctrls + classes + 1;
+    const auto  budget     = config.legacy ? 1 + enumerate + classes + ctrls : enumerate + classes;
+    const auto  menus      = menu_ctrls * config.menu_size;
+
+    auto lazy_ioctls = size_t(0);
+    auto ioctls      = size_t(0);
+    v4l2::query_controls(fd, v4l2::MenuMode::Lazy, &lazy_ioctls);
+    auto controls = v4l2::query_controls(fd, v4l2::MenuMode::Eager, &ioctls);
+    printf("%zu controls, %zu ioctls per enumeration (budget %zu), %zu with menus (budget %zu)\n", controls.size(), lazy_ioctls, budget, ioctls, budget + menus);
+
+    // the first start fills the cache, the next ones must not query menus again
+    // legacy drivers cannot be cached, as the control set is validated with VIDIOC_QUERY_EXT_CTRL
+    auto cache_dir = std::string("/tmp/v4l2-wlctl-benchmark-XXXXXX");
+    ensure(mkdtemp(cache_dir.data()) != nullptr);
+    setenv("XDG_CACHE_HOME", cache_dir.data(), 1);
+    const auto cold_menus = start_cached(fd);
+    const auto warm_menus = start_cached(fd);
+    printf("cached start: %llu menu queries cold, %llu warm (budget %s)\n", (unsigned long long)cold_menus, (unsigned long long)warm_menus, config.legacy ? "none" : "0");
+    measure("cached-start", args->iterations, [fd] { start_cached(fd); });
+    std::filesystem::remove_all(cache_dir);
+
+    auto values = std::vector<v4l2::ControlValue>();
+    for(const auto& ctrl : controls) {
+        if(ctrl.type == v4l2::ControlType::Int) {
+            values.push_back({ctrl.id, ctrl.current + 1});
+        }
+    }
+
+    measure("query_controls", args->iterations, [fd] { v4l2::query_controls(fd, v4l2::MenuMode::Lazy); });
+    measure("+ menus", args->iterations, [fd] { v4l2::query_controls(fd, v4l2::MenuMode::Eager); });
+    measure("batch-set", args->iterations, [fd, &values] { v4l2::set_controls(fd, values); });
+    measure("per-control-set", args->iterations, [fd, &values] {
+        for(const auto& value : values) {
+            v4l2::set_control(fd, value.id, value.value);
+        }
+    });
+    measure("refresh", args->iterations, [fd, &controls] { v4l2::read_values(fd, controls); });
+
+    // requests are reused, only the first iteration allocates
+    {
+        const auto media_fd = v4l2::open_device("fake-media");
+        auto       pool     = v4l2::RequestPool(media_fd, fd);
+        measure("request-set", args->iterations, [&pool, &values] {
+            if(const auto request = pool.acquire()) {
+                if(pool.set_controls(*request, values).ok && pool.queue(*request)) {
+                    pool.wait(*request, 1000);
+                }
+                pool.release(*request);
+            }
+        });
+        pool.print_stats(stdout, false);
+        v4l2::close_device(media_fd);
+    }
+
+    v4l2::close_device(fd);
+    v4l2::set_backend(nullptr);
+    ensure(lazy_ioctls <= budget && ioctls <= budget + menus, "enumeration exceeded its ioctl budget");
+    ensure(config.legacy || warm_menus == 0, "menu labels were not cached");
+    ensure(size_t(std::ranges::count(controls, v4l2::ControlType::Payload, &v4l2::Control::type)) == compounds, "compound controls were not enumerated");
+    return true;
+}
+} // namespace
+
+auto main(const int argc, const char* argv[]) -> int {
+    return run(argc, argv) ? 0 : 1;
+}
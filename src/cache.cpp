@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.hpp"
+#include "macros/unwrap.hpp"
+
+namespace v4l2 {
+namespace {
+constexpr auto cache_magic   = std::array{'v', '4', 'l', '2', 'w', 'l', 'c', 't'};
+constexpr auto cache_version = uint32_t(4);
+
+// file layout: CacheHeader, CacheControl[controls]
+// menu labels are resolved on demand, and the resolved ones are written to a separate file afterwards
+struct CacheHeader {
+    std::array<char, 8> magic;
+    uint32_t            version;
+    DeviceIdentity      identity;
+    // probes for validation
+    uint32_t first_id;
+    uint32_t last_id;
+    uint32_t controls;
+};
+
+struct CacheControl {
+    uint32_t      id;
+    uint32_t      type;
+    char          name[32];
+    int32_t       max;
+    int32_t       min;
+    int32_t       step;
+    uint32_t      flags;
+    PayloadLayout layout;
+};
+
+// file layout: MenuCacheHeader, { MenuCacheRecord, ControlMenu[count] }[records]
+// only read together with a valid descriptor cache, which guarantees the control set
+struct MenuCacheHeader {
+    std::array<char, 8> magic;
+    uint32_t            version;
+    DeviceIdentity      identity;
+    uint32_t            records;
+};
+
+// labels are reused only if the range did not change
+struct MenuCacheRecord {
+    uint32_t id;
+    int32_t  min;
+    int32_t  max;
+    uint32_t count;
+};
+
+enum CacheFlags : uint32_t {
+    ReadOnly  = 1 << 0,
+    WriteOnly = 1 << 1,
+    Inactive  = 1 << 2,
+    Volatile  = 1 << 3,
+    Execute   = 1 << 4,
+};
+
+auto operator==(const DeviceIdentity& a, const DeviceIdentity& b) -> bool {
+    return memcmp(&a, &b, sizeof(DeviceIdentity)) == 0;
+}
+
+auto get_cache_path(const DeviceIdentity& identity) -> std::optional<std::filesystem::path> {
+    auto dir = std::filesystem::path();
+    if(const auto xdg = getenv("XDG_CACHE_HOME"); xdg != nullptr && xdg[0] != '\0') {
+        dir = xdg;
+    } else if(const auto home = getenv("HOME"); home != nullptr) {
+        dir = std::filesystem::path(home) / ".cache";
+    } else {
+        return std::nullopt;
+    }
+
+    // fnv-1a over the fields that identify a device
+    auto hash = uint64_t(0xcbf29ce484222325);
+    for(const auto c : std::string_view((const char*)&identity, offsetof(DeviceIdentity, version))) {
+        hash = (hash ^ uint8_t(c)) * 0x100000001b3;
+    }
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+    return dir / "v4l2-wlctl" / name;
+}
+
+auto get_menu_cache_path(const std::filesystem::path& path) -> std::filesystem::path {
+    auto ret = path;
+    ret += ".menus";
+    return ret;
+}
+
+// maps the whole file, returns nullptr if it is missing or shorter than min_size
+auto map_file(const std::filesystem::path& path, const size_t min_size, size_t& size) -> const void* {
+    const auto file = open(path.c_str(), O_RDONLY);
+    if(file == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    size           = fstat(file, &st) == 0 ? size_t(st.st_size) : 0;
+    const auto map = size >= min_size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+    close(file);
+    return map != MAP_FAILED ? map : nullptr;
+}
+
+// write to a temporary file and rename, so that readers never see a partial file
+// unique per thread, devices of the same model may be enumerated concurrently
+auto write_file(const std::filesystem::path& path, const std::span<const std::span<const std::byte>> parts) -> bool {
+    auto error = std::error_code();
+    std::filesystem::create_directories(path.parent_path(), error);
+    ensure(!error);
+
+    const auto temp = path.string() + "." + std::to_string(gettid()) + ".tmp";
+    const auto file = open(temp.data(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ensure(file != -1);
+    auto ok = true;
+    for(const auto part : parts) {
+        ok = ok && write(file, part.data(), part.size()) == ssize_t(part.size());
+    }
+    close(file);
+    ensure(ok && rename(temp.data(), path.c_str()) == 0);
+    return true;
+}
+
+// fills menus of controls found in the menu cache, others are left unresolved
+auto load_menu_cache(const std::filesystem::path& path, const DeviceIdentity& identity, std::vector<Control>& controls) -> void {
+    auto       size = size_t(0);
+    const auto map  = map_file(path, sizeof(MenuCacheHeader), size);
+    if(map == nullptr) {
+        return;
+    }
+    const auto& header = *(const MenuCacheHeader*)map;
+    if(header.magic == cache_magic && header.version == cache_version && header.identity == identity) {
+        // controls and records are both in enumeration order
+        auto       ptr     = (const std::byte*)(&header + 1);
+        const auto end     = (const std::byte*)map + size;
+        auto       control = controls.begin();
+        for(auto i = 0u; i < header.records && end - ptr >= ptrdiff_t(sizeof(MenuCacheRecord)); i += 1) {
+            const auto& record = *(const MenuCacheRecord*)ptr;
+            const auto  items  = (const ControlMenu*)(&record + 1);
+            ptr                = (const std::byte*)(items + record.count);
+            if(ptr > end) {
+                break;
+            }
+            control = std::find_if(control, controls.end(), [&record](const Control& c) { return c.id == record.id; });
+            if(control == controls.end()) {
+                break;
+            }
+            if(is_menu(control->type) && control->min == record.min && control->max == record.max) {
+                control->menus.assign(items, items + record.count);
+                for(auto& item : control->menus) {
+                    item.name[sizeof(item.name) - 1] = '\0';
+                }
+            }
+        }
+    }
+    munmap((void*)map, size);
+}
+
+// returns nullopt if the cache is missing, stale or broken
+// first_id is the id of the first control of the device
+auto load_cache(const int fd, const std::filesystem::path& path, const DeviceIdentity& identity, const uint32_t first_id) -> std::optional<std::vector<Control>> {
+    auto       size = size_t(0);
+    const auto map  = map_file(path, sizeof(CacheHeader), size);
+    if(map == nullptr) {
+        return std::nullopt;
+    }
+
+    auto ret = std::optional<std::vector<Control>>();
+    do {
+        const auto& header = *(const CacheHeader*)map;
+        if(header.magic != cache_magic || header.version != cache_version || !(header.identity == identity) ||
+           size != sizeof(CacheHeader) + sizeof(CacheControl) * header.controls) {
+            break;
+        }
+        // the control set is stable as long as it starts and ends with the same ids
+        if(first_id != header.first_id || next_control_id(fd, header.last_id).has_value()) {
+            break;
+        }
+
+        const auto controls = (const CacheControl*)(&header + 1);
+        auto&      vec      = ret.emplace();
+        vec.reserve(header.controls);
+        for(auto i = 0u; i < header.controls; i += 1) {
+            const auto& cached  = controls[i];
+            auto&       control = vec.emplace_back(Control{
+                .id               = cached.id,
+                .type             = ControlType(cached.type),
+                .name             = {},
+                .max              = cached.max,
+                .min              = cached.min,
+                .step             = cached.step,
+                .current          = 0,
+                .menus            = {},
+                .layout           = cached.layout,
+                .ro               = bool(cached.flags & ReadOnly),
+                .wo               = bool(cached.flags & WriteOnly),
+                .inactive         = bool(cached.flags & Inactive),
+                .is_volatile      = bool(cached.flags & Volatile),
+                .execute_on_write = bool(cached.flags & Execute),
+                .cached           = true,
+            });
+            memcpy(control.name, cached.name, 32);
+            control.name[31] = '\0';
+        }
+    } while(0);
+
+    munmap((void*)map, size);
+    return ret;
+}
+
+auto save_cache(const int fd, const std::filesystem::path& path, const DeviceIdentity& identity, const uint32_t first_id, const std::vector<Control>& controls) -> bool {
+    auto header = CacheHeader{
+        .magic    = cache_magic,
+        .version  = cache_version,
+        .identity = identity,
+        .first_id = 0,
+        .last_id  = 0,
+        .controls = uint32_t(controls.size()),
+    };
+    // walk raw ids once more, controls may end with unsupported ones
+    // only paid when the cache is missing
+    header.first_id = first_id;
+    header.last_id  = first_id;
+    while(const auto next = next_control_id(fd, header.last_id)) {
+        header.last_id = *next;
+    }
+
+    auto cached_controls = std::vector<CacheControl>();
+    for(const auto& control : controls) {
+        auto& cached = cached_controls.emplace_back(CacheControl{
+            .id     = control.id,
+            .type   = uint32_t(control.type),
+            .name   = {},
+            .max    = control.max,
+            .min    = control.min,
+            .step   = control.step,
+            .flags  = (control.ro ? ReadOnly : 0u) | (control.wo ? WriteOnly : 0u) | (control.inactive ? Inactive : 0u) |
+                      (control.is_volatile ? Volatile : 0u) | (control.execute_on_write ? Execute : 0u),
+            .layout = control.layout,
+        });
+        memcpy(cached.name, control.name, 32);
+    }
+
+    const auto parts = std::array{
+        std::as_bytes(std::span(&header, 1)),
+        std::as_bytes(std::span(cached_controls)),
+    };
+    return write_file(path, parts);
+}
+} // namespace
+
+auto query_controls_cached(const int fd) -> std::vector<Control> {
+    const auto identity = query_identity(fd);
+    const auto path     = identity ? get_cache_path(*identity) : std::nullopt;
+    // the cache is validated with VIDIOC_QUERY_EXT_CTRL, drivers without it are never cached
+    // neither are devices without controls
+    const auto first_id = path ? next_control_id(fd, 0) : std::nullopt;
+    if(!first_id) {
+        return query_controls(fd, MenuMode::Lazy);
+    }
+    if(auto controls = load_cache(fd, *path, *identity, *first_id)) {
+        load_menu_cache(get_menu_cache_path(*path), *identity, *controls);
+        read_values(fd, *controls);
+        return std::move(*controls);
+    }
+    auto controls = query_controls(fd, MenuMode::Lazy);
+    if(!save_cache(fd, *path, *identity, *first_id, controls)) {
+        line_warn("failed to write control cache");
+    }
+    return controls;
+}
+
+auto save_menu_cache(const int fd, ControlTable& table) -> bool {
+    if(table.menus_queried == 0) {
+        return true;
+    }
+    unwrap(identity, query_identity(fd));
+    unwrap(path, get_cache_path(identity));
+
+    auto header = MenuCacheHeader{
+        .magic    = cache_magic,
+        .version  = cache_version,
+        .identity = identity,
+        .records  = 0,
+    };
+    auto body = std::vector<std::byte>();
+    for(auto i = 0u; i < table.size(); i += 1) {
+        if(!table.is_menu_resolved(i)) {
+            continue;
+        }
+        const auto count  = table.get_menu_size(i);
+        const auto record = MenuCacheRecord{
+            .id    = table.ids[i],
+            .min   = table.mins[i],
+            .max   = table.maxs[i],
+            .count = uint32_t(count),
+        };
+        const auto record_bytes = std::as_bytes(std::span(&record, 1));
+        body.insert(body.end(), record_bytes.begin(), record_bytes.end());
+        for(auto m = 0u; m < count; m += 1) {
+            auto       item  = ControlMenu{.name = {}, .index = uint32_t(table.get_menu_value(i, m))};
+            const auto label = table.get_menu_label(i, m);
+            memcpy(item.name, label.data(), std::min(label.size(), sizeof(item.name) - 1));
+            const auto item_bytes = std::as_bytes(std::span(&item, 1));
+            body.insert(body.end(), item_bytes.begin(), item_bytes.end());
+        }
+        header.records += 1;
+    }
+
+    const auto parts = std::array{
+        std::as_bytes(std::span(&header, 1)),
+        std::span<const std::byte>(body),
+    };
+    ensure(write_file(get_menu_cache_path(path), parts));
+    table.menus_queried = 0;
+    return true;
+}
+} // namespace v4l2
@@ -0,0 +1,14 @@
+#pragma once
+#include "control-table.hpp"
+
+namespace v4l2 {
+// same as query_controls, but control descriptors are loaded from
+// $XDG_CACHE_HOME/v4l2-wlctl if the device is known, so only the current values are read
+// flags are the ones at the time of caching
+// menus are left unresolved as with MenuMode::Lazy, except the ones saved by save_menu_cache
+// drivers without VIDIOC_QUERY_EXT_CTRL are not cached, and are enumerated on every call
+auto query_controls_cached(int fd) -> std::vector<Control>;
+// writes menus resolved by the table back to the cache, so that the next start needs no QUERYMENU
+// does nothing if the table resolved no menu from the device
+auto save_menu_cache(int fd, ControlTable& table) -> bool;
+} // namespace v4l2
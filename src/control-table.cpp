@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+#include <linux/videodev2.h>
+
+#include "control-table.hpp"
+
+namespace v4l2 {
+auto ControlTable::append_menus(const std::span<const ControlMenu> items) -> void {
+    for(const auto& item : items) {
+        menus.push_back({uint32_t(menu_arena.size()), item.index});
+        menu_arena.append(item.name, strnlen(item.name, sizeof(item.name)));
+        menu_arena.push_back('\0');
+    }
+}
+
+auto ControlTable::resolve_menus(const size_t index) -> void {
+    if(menu_counts[index] != unresolved) {
+        return;
+    }
+    // old entries stay in the arena until the next assign()
+    const auto items   = query_menu(fd, ids[index], types[index], mins[index], maxs[index]);
+    menu_begins[index] = menus.size();
+    menu_counts[index] = items.size();
+    append_menus(items);
+    menus_queried += 1;
+}
+
+auto ControlTable::assign(const int fd, const std::span<const Control> controls) -> void {
+    this->fd      = fd;
+    menus_queried = 0;
+    ids.clear();
+    types.clear();
+    mins.clear();
+    maxs.clear();
+    steps.clear();
+    currents.clear();
+    flags.clear();
+    names.clear();
+    menu_begins.clear();
+    menu_counts.clear();
+    menus.clear();
+    payload_indices.clear();
+    stale_ranges.clear();
+    payloads.clear();
+    name_arena.clear();
+    menu_arena.clear();
+    id_index.clear();
+    name_index.clear();
+
+    for(const auto& ctrl : controls) {
+        ids.push_back(ctrl.id);
+        types.push_back(ctrl.type);
+        mins.push_back(ctrl.min);
+        maxs.push_back(ctrl.max);
+        steps.push_back(ctrl.step);
+        currents.push_back(ctrl.current);
+        flags.push_back((ctrl.ro ? ReadOnly : 0) | (ctrl.wo ? WriteOnly : 0) | (ctrl.inactive ? Inactive : 0) |
+                        (ctrl.is_volatile ? Volatile : 0) | (ctrl.execute_on_write ? Execute : 0));
+        names.push_back(name_arena.size());
+        name_arena.append(ctrl.name, strnlen(ctrl.name, sizeof(ctrl.name)));
+        name_arena.push_back('\0');
+        menu_begins.push_back(menus.size());
+        menu_counts.push_back(is_menu(ctrl.type) && ctrl.menus.empty() ? unresolved : ctrl.menus.size());
+        stale_ranges.push_back(ctrl.cached);
+        append_menus(ctrl.menus);
+        if(has_payload(ctrl.type)) {
+            payload_indices.push_back(payloads.size());
+            payloads.push_back(make_payload(ctrl.id, ctrl.layout));
+        } else {
+            payload_indices.push_back(unresolved);
+        }
+    }
+
+    // the arena does not grow anymore, views are stable from here
+    for(auto i = 0u; i < ids.size(); i += 1) {
+        id_index.emplace(ids[i], i);
+        name_index.emplace(get_name(i), i);
+    }
+}
+
+auto ControlTable::size() const -> size_t {
+    return ids.size();
+}
+
+auto ControlTable::find(const uint32_t id) const -> std::optional<size_t> {
+    const auto p = id_index.find(id);
+    return p != id_index.end() ? std::optional<size_t>(p->second) : std::nullopt;
+}
+
+auto ControlTable::find(const std::string_view name) const -> std::optional<size_t> {
+    const auto p = name_index.find(name);
+    return p != name_index.end() ? std::optional<size_t>(p->second) : std::nullopt;
+}
+
+auto ControlTable::get_name(const size_t index) const -> std::string_view {
+    return name_arena.data() + names[index];
+}
+
+auto ControlTable::is_active(const size_t index) const -> bool {
+    return !(flags[index] & (ReadOnly | Inactive));
+}
+
+auto ControlTable::is_menu_resolved(const size_t index) const -> bool {
+    return is_menu(types[index]) && menu_counts[index] != unresolved;
+}
+
+auto ControlTable::get_menu_size(const size_t index) -> size_t {
+    resolve_menus(index);
+    return menu_counts[index];
+}
+
+auto ControlTable::get_menu_label(const size_t index, const size_t menu) -> std::string_view {
+    resolve_menus(index);
+    return menu_arena.data() + menus[menu_begins[index] + menu].label;
+}
+
+auto ControlTable::get_menu_value(const size_t index, const size_t menu) -> int32_t {
+    resolve_menus(index);
+    return menus[menu_begins[index] + menu].value;
+}
+
+auto ControlTable::get_payload(const size_t index) -> Payload& {
+    return payloads[payload_indices[index]];
+}
+
+auto ControlTable::read_payload(const size_t index) -> bool {
+    return !(flags[index] & WriteOnly) && v4l2::get_payload(fd, get_payload(index));
+}
+
+auto ControlTable::read_values(std::vector<size_t>& failed) -> void {
+    read_buffer.clear();
+    for(auto i = 0u; i < ids.size(); i += 1) {
+        if(!(flags[i] & WriteOnly) && !has_payload(types[i])) {
+            read_buffer.push_back({ids[i], 0});
+        }
+    }
+    v4l2::read_values(fd, read_buffer);
+
+    // both are ordered by id
+    failed.clear();
+    auto index = size_t(0);
+    for(auto i = 0u; i < ids.size(); i += 1) {
+        if(flags[i] & WriteOnly || has_payload(types[i])) {
+            continue;
+        }
+        const auto& value = read_buffer[index++];
+        if(value.id != 0) {
+            currents[i] = value.value;
+        } else {
+            failed.push_back(i);
+        }
+    }
+}
+
+auto ControlTable::refresh_range(const size_t index) -> void {
+    // on failure the cached range is kept, the driver validates the value anyway
+    stale_ranges[index] = false;
+    const auto control  = query_control(fd, ids[index]);
+    if(!control) {
+        return;
+    }
+    if(is_menu(types[index]) && (control->min != mins[index] || control->max != maxs[index])) {
+        menu_counts[index] = unresolved;
+    }
+    mins[index]  = control->min;
+    maxs[index]  = control->max;
+    steps[index] = control->step;
+}
+
+auto ControlTable::prepare_write(const size_t index, const int32_t value) -> std::optional<int32_t> {
+    if(stale_ranges[index]) {
+        refresh_range(index);
+    }
+    const auto min  = mins[index];
+    const auto max  = maxs[index];
+    const auto step = steps[index];
+
+    auto quantized = int64_t();
+    switch(types[index]) {
+    case ControlType::Bitmask:
+        // max holds the valid bits
+        quantized = int32_t(uint32_t(value) & uint32_t(max));
+        break;
+    case ControlType::Int:
+        // same rounding as the kernel, in 64 bits since max - min may overflow
+        quantized = std::clamp<int64_t>(value, min, max);
+        if(step > 1) {
+            quantized = min + (quantized - min + step / 2) / step * step;
+            if(quantized > max) {
+                quantized -= step;
+            }
+        }
+        break;
+    default:
+        quantized = std::clamp<int64_t>(value, min, max);
+        break;
+    }
+    const auto result = int32_t(quantized);
+    if(result != value) {
+        write_stats.clamped += 1;
+    }
+    if(is_cached(index) && !(flags[index] & Execute) && currents[index] == result) {
+        write_stats.skipped += 1;
+        return std::nullopt;
+    }
+    write_stats.written += 1;
+    currents[index] = result;
+    return result;
+}
+
+auto ControlTable::is_cached(const size_t index) const -> bool {
+    return !(flags[index] & (WriteOnly | Volatile));
+}
+
+auto ControlTable::print_write_stats(FILE* const out, const bool json) const -> void {
+    if(json) {
+        fprintf(out, "\"writes\":{\"written\":%" PRIu64 ",\"skipped\":%" PRIu64 ",\"clamped\":%" PRIu64 "}", write_stats.written, write_stats.skipped, write_stats.clamped);
+    } else {
+        fprintf(out, "writes: %" PRIu64 " written, %" PRIu64 " skipped, %" PRIu64 " clamped\n", write_stats.written, write_stats.skipped, write_stats.clamped);
+    }
+}
+
+auto ControlTable::apply_event(const ControlEvent& event, const Payload* const payload) -> std::optional<size_t> {
+    const auto index = find(event.id);
+    if(!index) {
+        return std::nullopt;
+    }
+    const auto i = *index;
+    if(event.changes & V4L2_EVENT_CTRL_CH_VALUE) {
+        if(has_payload(types[i]) && payload != nullptr) {
+            // the layout is fixed, only the value is copied
+            auto& dest = get_payload(i);
+            std::ranges::copy(payload->data, dest.data.begin());
+            dest.size = payload->size;
+        } else if(has_payload(types[i])) {
+            // events do not carry payloads
+            read_payload(i);
+        } else {
+            currents[i] = event.value;
+        }
+    }
+    if(event.changes & V4L2_EVENT_CTRL_CH_FLAGS) {
+        flags[i] = (flags[i] & (WriteOnly | Volatile | Execute)) | (event.ro ? ReadOnly : 0) | (event.inactive ? Inactive : 0);
+    }
+    if(event.changes & V4L2_EVENT_CTRL_CH_RANGE) {
+        mins[i]         = event.min;
+        maxs[i]         = event.max;
+        steps[i]        = event.step;
+        stale_ranges[i] = false;
+        if(is_menu(types[i])) {
+            menu_counts[i] = unresolved;
+        }
+    }
+    return i;
+}
+} // namespace v4l2
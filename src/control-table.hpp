@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+#include "v4l2.hpp"
+
+namespace v4l2 {
+// contiguous control storage, one array per field
+// names and menu labels are interned into arenas, controls are referred by index
+// assign() reuses the memory of the previous contents
+// menus are resolved from the device on first access and memoized
+class ControlTable {
+  public:
+    enum Flags : uint8_t {
+        ReadOnly  = 1 << 0,
+        WriteOnly = 1 << 1,
+        Inactive  = 1 << 2,
+        Volatile  = 1 << 3,
+        Execute   = 1 << 4, // execute on write
+    };
+
+    struct WriteStats {
+        uint64_t written;
+        uint64_t skipped; // value already current
+        uint64_t clamped; // out of range or off step
+    };
+
+    std::vector<uint32_t>    ids;
+    std::vector<ControlType> types;
+    std::vector<int32_t>     mins;
+    std::vector<int32_t>     maxs;
+    std::vector<int32_t>     steps;
+    std::vector<int32_t>     currents;
+    std::vector<uint8_t>     flags;
+    WriteStats               write_stats   = {};
+    size_t                   menus_queried = 0; // menus resolved from the device since assign()
+
+  private:
+    struct Menu {
+        uint32_t label; // offset in menu_arena
+        uint32_t value;
+    };
+
+    constexpr static auto unresolved = ~uint32_t(0);
+
+    int                                             fd = -1;
+    std::vector<uint32_t>                           names; // offset in name_arena
+    std::vector<uint32_t>                           menu_begins;
+    std::vector<uint32_t>                           menu_counts; // or unresolved
+    std::vector<Menu>                               menus;
+    std::vector<uint32_t>                           payload_indices; // or unresolved
+    std::vector<bool>                               stale_ranges;    // loaded from the descriptor cache and not queried since
+    std::vector<ControlValue>                       read_buffer;     // reused by read_values()
+    std::vector<Payload>                            payloads;
+    std::string                                     name_arena;
+    std::string                                     menu_arena;
+    std::unordered_map<uint32_t, uint32_t>          id_index;
+    std::unordered_map<std::string_view, uint32_t> name_index; // views into name_arena
+
+    auto append_menus(std::span<const ControlMenu> items) -> void;
+    auto resolve_menus(size_t index) -> void;
+    auto refresh_range(size_t index) -> void;
+
+  public:
+    auto assign(int fd, std::span<const Control> controls) -> void;
+    auto size() const -> size_t;
+    auto find(uint32_t id) const -> std::optional<size_t>;
+    auto find(std::string_view name) const -> std::optional<size_t>;
+    auto get_name(size_t index) const -> std::string_view;
+    auto is_active(size_t index) const -> bool;
+    auto is_menu_resolved(size_t index) const -> bool;
+    auto get_menu_size(size_t index) -> size_t;
+    auto get_menu_label(size_t index, size_t menu) -> std::string_view;
+    auto get_menu_value(size_t index, size_t menu) -> int32_t;
+    // value of an Int64 or Payload control, buffers are allocated by assign() and reused
+    auto get_payload(size_t index) -> Payload&;
+    // reads the device into get_payload(index)
+    auto read_payload(size_t index) -> bool;
+    // refreshes currents of readable scalar controls in bulk
+    // indices of controls that failed to read are stored in failed, their currents are left as is
+    auto read_values(std::vector<size_t>& failed) -> void;
+    // write-through: clamps and quantizes the value and records it as current, not for payload controls
+    // returns the value to write, or nullopt if writing it would be a no-op
+    // volatile and execute-on-write controls are always written
+    // ranges loaded from the descriptor cache are queried from the device before the first clamp
+    auto prepare_write(size_t index, int32_t value) -> std::optional<int32_t>;
+    // whether currents[index] can be trusted instead of reading the device
+    auto is_cached(size_t index) const -> bool;
+    // a line, or a json member "writes":{...}
+    auto print_write_stats(FILE* out, bool json) const -> void;
+    // returns the index of the patched control
+    // value changes of payload controls take payload if given, the device is read otherwise
+    auto apply_event(const ControlEvent& event, const Payload* payload = nullptr) -> std::optional<size_t>;
+};
+} // namespace v4l2
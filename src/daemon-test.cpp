@@ -0,0 +1,91 @@
+#include <csignal>
+#include <filesystem>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "macros/unwrap.hpp"
+#include "protocol.hpp"
+
+// round trips requests through v4l2-wlctl-daemon serving a fake device
+// usage: v4l2-wlctl-daemon-test DAEMON
+namespace {
+// the first int, bool and menu controls of the user class of FakeBackend
+constexpr auto int_name  = "Int 9963776";
+constexpr auto bool_name = "Bool 9963777";
+
+auto connect_retry(const char* const path) -> std::optional<int> {
+    for(auto i = 0; i < 500; i += 1) {
+        if(std::filesystem::exists(path)) {
+            if(const auto sock = protocol::connect_daemon(path)) {
+                return sock;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    bail("daemon did not start");
+}
+
+auto expect(const int sock, const std::vector<std::string_view>& request, const std::string_view expected) -> bool {
+    unwrap(response, protocol::request(sock, protocol::join_fields(request)));
+    if(response != expected) {
+        const auto message = protocol::join_fields(request);
+        printf("request:  %s", message.data());
+        printf("expected: %.*s\n", int(expected.size()), expected.data());
+        printf("got:      %s\n", response.data());
+        return false;
+    }
+    return true;
+}
+
+auto run_requests(const int sock) -> bool {
+    const auto ok = [](const std::string_view value) { return std::string("ok\t") + std::string(value); };
+    ensure(expect(sock, {"get", "fake", int_name}, ok("0")));
+    ensure(expect(sock, {"set", "fake", int_name, "42"}, "ok"));
+    ensure(expect(sock, {"get", "fake", int_name}, ok("42")));
+    // clamped to the maximum by the daemon
+    ensure(expect(sock, {"set", "fake", int_name, "5000"}, "ok"));
+    ensure(expect(sock, {"get", "fake", int_name}, ok("1000")));
+    ensure(expect(sock, {"batch", "fake", int_name, "7", bool_name, "1"}, "ok"));
+    ensure(expect(sock, {"get", "fake", int_name}, ok("7")));
+    ensure(expect(sock, {"get", "fake", bool_name}, ok("1")));
+    ensure(expect(sock, {"set", "fake", int_name, "x"}, "error\tinvalid value"));
+    ensure(expect(sock, {"get", "fake", "Missing"}, "error\tno such control"));
+    return true;
+}
+
+auto run(const int argc, const char* argv[]) -> bool {
+    ensure(argc == 2, "usage: v4l2-wlctl-daemon-test DAEMON");
+
+    // the daemon also writes its descriptor cache there
+    auto dir = std::string("/tmp/v4l2-wlctl-daemon-test-XXXXXX");
+    ensure(mkdtemp(dir.data()) != nullptr);
+    const auto socket_path = dir + "/daemon.sock";
+
+    const auto pid = fork();
+    ensure(pid != -1);
+    if(pid == 0) {
+        setenv("XDG_CACHE_HOME", dir.data(), 1);
+        execl(argv[1], argv[1], "--fake", socket_path.data(), nullptr);
+        _exit(127);
+    }
+
+    auto ok = false;
+    if(const auto sock = connect_retry(socket_path.data())) {
+        ok = run_requests(*sock);
+        close(*sock);
+    }
+    kill(pid, SIGTERM);
+    auto status = 0;
+    waitpid(pid, &status, 0);
+    std::filesystem::remove_all(dir);
+    ensure(ok);
+    ensure(WIFEXITED(status) && WEXITSTATUS(status) == 0, "daemon did not exit cleanly");
+    return true;
+}
+} // namespace
+
+auto main(const int argc, const char* argv[]) -> int {
+    return run(argc, argv) ? 0 : 1;
+}
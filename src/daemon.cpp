@@ -0,0 +1,306 @@
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cache.hpp"
+#include "control-table.hpp"
+#include "fake.hpp"
+#include "macros/unwrap.hpp"
+#include "protocol.hpp"
+#include "publisher.hpp"
+#include "value-text.hpp"
+
+namespace {
+struct Device {
+    int                              fd;
+    v4l2::ControlTable               table;
+    std::unique_ptr<v4l2::Publisher> publisher;
+
+    // writes through the table, values that are already current are not sent
+    // error_index refers to values
+    auto write_values(const std::span<const v4l2::ControlValue> values) -> v4l2::BatchResult {
+        auto writes   = std::vector<v4l2::ControlValue>();
+        auto indices  = std::vector<size_t>(); // into the table
+        auto sources  = std::vector<size_t>(); // into values
+        auto previous = std::vector<int32_t>();
+        for(auto i = 0u; i < values.size(); i += 1) {
+            const auto index = *table.find(values[i].id);
+            const auto old   = table.currents[index];
+            if(const auto value = table.prepare_write(index, values[i].value)) {
+                writes.push_back({values[i].id, *value});
+                indices.push_back(index);
+                sources.push_back(i);
+                previous.push_back(old);
+            }
+        }
+        const auto result = v4l2::set_controls(fd, writes);
+        if(!result.ok) {
+            // classes before the failed one may have been applied, so the device is asked
+            v4l2::read_values(fd, writes);
+        }
+        for(auto i = 0u; i < writes.size(); i += 1) {
+            table.currents[indices[i]] = result.ok || writes[i].id != 0 ? writes[i].value : previous[i];
+            publisher->publish(table, indices[i]);
+        }
+        return {result.ok, result.error_index < writes.size() ? sources[result.error_index] : values.size()};
+    }
+
+    ~Device() {
+        v4l2::close_device(fd);
+    }
+
+    // keeps the mirror in sync with changes made by other processes
+    auto process_events() -> void {
+        while(const auto event = v4l2::dequeue_event(fd)) {
+            if(const auto index = table.apply_event(*event)) {
+                publisher->publish(table, *index);
+            }
+        }
+    }
+};
+
+struct Client {
+    int         sock;
+    std::string buffer;
+};
+
+// devices are opened on first use and kept open
+struct Daemon {
+    std::unordered_map<std::string, std::unique_ptr<Device>> devices;
+
+    auto get_device(const std::string_view path) -> Device* {
+        const auto key = std::string(path);
+        if(const auto p = devices.find(key); p != devices.end()) {
+            return p->second.get();
+        }
+        const auto fd = v4l2::open_device(key.data());
+        if(fd == -1) {
+            return nullptr;
+        }
+        auto& device = devices[key];
+        device       = std::unique_ptr<Device>(new Device{.fd = fd, .table = {}, .publisher = {}});
+        device->table.assign(fd, v4l2::query_controls_cached(fd));
+        device->publisher.reset(new v4l2::Publisher(key, device->table));
+        for(const auto id : device->table.ids) {
+            v4l2::subscribe_control_events(fd, id);
+        }
+        return device.get();
+    }
+
+    auto handle(const std::string_view line) -> std::string {
+        const auto error = [](const std::string_view message) {
+            return protocol::join_fields({"error", message});
+        };
+
+        const auto fields = protocol::split_fields(line);
+        if(fields.size() < 3) {
+            return error("malformed request");
+        }
+        const auto command = fields[0];
+        const auto device  = get_device(fields[1]);
+        if(device == nullptr) {
+            return error("failed to open device");
+        }
+
+        auto values = std::vector<v4l2::ControlValue>();
+        for(auto i = 2u; i < fields.size(); i += 2) {
+            const auto index = device->table.find(fields[i]);
+            if(!index) {
+                return error("no such control");
+            }
+            if(v4l2::has_payload(device->table.types[*index])) {
+                return error("payload controls are not supported");
+            }
+            if(command == "get") {
+                values.push_back({device->table.ids[*index], 0});
+                break;
+            }
+            if(i + 1 >= fields.size()) {
+                return error("missing value");
+            }
+            const auto value = v4l2::parse_value(device->table.types[*index], fields[i + 1]);
+            if(!value) {
+                return error("invalid value");
+            }
+            values.push_back({device->table.ids[*index], *value});
+        }
+
+        if(command == "get" && fields.size() == 3) {
+            // the table follows control events, only volatile and write-only values need the device
+            const auto index = *device->table.find(values[0].id);
+            const auto value = device->table.is_cached(index) ? std::optional(device->table.currents[index]) : v4l2::get_control(device->fd, values[0].id);
+            if(!value) {
+                return error("failed to get control value");
+            }
+            auto text = std::string();
+            v4l2::format_value(device->table.types[index], *value, text);
+            return protocol::join_fields({"ok", text});
+        } else if(command == "set" && fields.size() == 4) {
+            if(!device->write_values(values).ok) {
+                return error("failed to set control value");
+            }
+            return protocol::join_fields({"ok"});
+        } else if(command == "batch") {
+            const auto result = device->write_values(values);
+            if(result.ok) {
+                return protocol::join_fields({"ok"});
+            }
+            if(result.error_index < values.size()) {
+                return error(std::string("rejected ") + std::string(fields[2 + result.error_index * 2]));
+            }
+            return error("failed to set control values");
+        } else {
+            return error("unknown command");
+        }
+    }
+
+    // returns false if the client should be dropped
+    auto process(Client& client) -> bool {
+        char       buf[4096];
+        const auto len = read(client.sock, buf, sizeof(buf));
+        if(len <= 0) {
+            return false;
+        }
+        client.buffer.append(buf, len);
+
+        auto response = std::string();
+        auto begin    = size_t(0);
+        for(auto end = client.buffer.find(protocol::terminator); end != client.buffer.npos; end = client.buffer.find(protocol::terminator, begin)) {
+            response += handle(std::string_view(client.buffer).substr(begin, end - begin));
+            begin = end + 1;
+        }
+        client.buffer.erase(0, begin);
+
+        // responses of pipelined requests go out in one write
+        return response.empty() || send(client.sock, response.data(), response.size(), MSG_NOSIGNAL) == ssize_t(response.size());
+    }
+};
+
+auto print_usage() -> void {
+    printf("usage: v4l2-wlctl-daemon [--fake] [SOCKET]\n");
+    printf("  SOCKET  path to listen on, default $XDG_RUNTIME_DIR/v4l2-wlctl.sock\n");
+    printf("  --fake  serve an in-memory device for every path instead of opening it, for testing\n");
+}
+
+// runs until SIGINT or SIGTERM
+auto run(const int argc, const char* argv[]) -> bool {
+    auto path = std::optional<std::string>();
+    auto fake = std::optional<v4l2::FakeBackend>();
+    for(auto i = 1; i < argc; i += 1) {
+        const auto arg = std::string_view(argv[i]);
+        if(arg == "--fake") {
+            fake.emplace(v4l2::FakeConfig());
+        } else if(!arg.starts_with("-") && !path) {
+            path = std::string(arg);
+        } else {
+            print_usage();
+            return false;
+        }
+    }
+    if(!path) {
+        path = protocol::get_socket_path();
+        ensure(path);
+    }
+    if(fake) {
+        v4l2::set_backend(&*fake);
+    }
+
+    auto addr       = sockaddr_un();
+    addr.sun_family = AF_UNIX;
+    ensure(path->size() < sizeof(addr.sun_path), "socket path too long");
+    strcpy(addr.sun_path, path->data());
+
+    const auto sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    ensure(sock != -1);
+    unlink(path->data());
+    ensure(bind(sock, (sockaddr*)&addr, sizeof(addr)) == 0, "failed to bind socket");
+    ensure(listen(sock, 16) == 0);
+
+    // terminates gracefully, so that mirrors are unlinked
+    auto signals = sigset_t();
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    ensure(sigprocmask(SIG_BLOCK, &signals, nullptr) == 0);
+    const auto signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+    ensure(signal_fd != -1);
+
+    auto daemon  = Daemon();
+    auto clients = std::vector<Client>();
+    auto fds     = std::vector<pollfd>();
+    while(true) {
+        fds.clear();
+        fds.push_back({.fd = sock, .events = POLLIN, .revents = 0});
+        fds.push_back({.fd = signal_fd, .events = POLLIN, .revents = 0});
+        for(const auto& client : clients) {
+            fds.push_back({.fd = client.sock, .events = POLLIN, .revents = 0});
+        }
+        // control events of opened devices, after the clients
+        for(const auto& [path, device] : daemon.devices) {
+            fds.push_back({.fd = device->fd, .events = POLLPRI, .revents = 0});
+        }
+        if(poll(fds.data(), fds.size(), -1) == -1) {
+            ensure(errno == EINTR);
+            continue;
+        }
+        if(fds[1].revents & POLLIN) {
+            break;
+        }
+
+        // devices do not change until clients are processed
+        // unplugged devices are dropped, so that the next request reopens them
+        auto device_fd = fds.begin() + 2 + clients.size();
+        for(auto p = daemon.devices.begin(); p != daemon.devices.end();) {
+            const auto revents = (device_fd++)->revents;
+            if(revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                line_warn("device disconnected");
+                p = daemon.devices.erase(p);
+                continue;
+            }
+            if(revents & POLLPRI) {
+                p->second->process_events();
+            }
+            ++p;
+        }
+
+        // clients first, accepting shifts indices
+        for(auto i = clients.size(); i > 0; i -= 1) {
+            if(fds[1 + i].revents == 0) {
+                continue;
+            }
+            if(!daemon.process(clients[i - 1])) {
+                close(clients[i - 1].sock);
+                clients.erase(clients.begin() + i - 1);
+            }
+        }
+        if(fds[0].revents & POLLIN) {
+            if(const auto client = accept4(sock, nullptr, nullptr, SOCK_CLOEXEC); client != -1) {
+                clients.push_back({client, {}});
+            }
+        }
+    }
+
+    for(const auto& client : clients) {
+        close(client.sock);
+    }
+    close(signal_fd);
+    close(sock);
+    unlink(path->data());
+    // devices are closed before the backend goes away
+    daemon.devices.clear();
+    v4l2::set_backend(nullptr);
+    return true;
+}
+} // namespace
+
+auto main(const int argc, const char* argv[]) -> int {
+    return run(argc, argv) ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <linux/media.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fake.hpp"
+
+namespace v4l2 {
+namespace {
+auto fail(const int error) -> int {
+    errno = error;
+    return -1;
+}
+
+template <class Query>
+auto copy_query(const v4l2_query_ext_ctrl& src, Query& dest) -> void {
+    dest.id      = src.id;
+    dest.type    = src.type;
+    dest.minimum = src.minimum;
+    dest.maximum = src.maximum;
+    dest.step    = src.step;
+    dest.flags   = src.flags;
+    memcpy(dest.name, src.name, sizeof(dest.name));
+}
+} // namespace
+
+auto FakeBackend::find(const uint32_t id) -> FakeControl* {
+    const auto p = std::ranges::lower_bound(controls, id, {}, &FakeControl::id);
+    return p != controls.end() && p->id == id ? &*p : nullptr;
+}
+
+auto FakeBackend::find_next(const uint32_t id, const bool next_ctrl, const bool next_compound) -> FakeControl* {
+    for(auto p = std::ranges::upper_bound(controls, id, {}, &FakeControl::id); p != controls.end(); p += 1) {
+        if(p->payload.empty() ? next_ctrl : next_compound) {
+            return &*p;
+        }
+    }
+    return nullptr;
+}
+
+auto FakeBackend::query(v4l2_query_ext_ctrl& query) -> int {
+    const auto next_ctrl     = bool(query.id & V4L2_CTRL_FLAG_NEXT_CTRL);
+    const auto next_compound = bool(query.id & V4L2_CTRL_FLAG_NEXT_COMPOUND);
+    const auto id            = query.id & ~(V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND);
+    const auto ctrl          = next_ctrl || next_compound ? find_next(id, next_ctrl, next_compound) : find(id);
+    if(ctrl == nullptr) {
+        return fail(EINVAL);
+    }
+    const auto compound = !ctrl->payload.empty();
+    query               = v4l2_query_ext_ctrl();
+    query.id            = ctrl->id;
+    query.type          = ctrl->type;
+    query.minimum       = ctrl->min;
+    query.maximum       = ctrl->max;
+    query.step          = ctrl->step;
+    query.flags         = ctrl->flags;
+    query.elem_size     = compound ? 1 : sizeof(int32_t);
+    query.elems         = compound ? ctrl->payload.size() : 1;
+    query.nr_of_dims    = compound ? 1 : 0;
+    query.dims[0]       = compound ? ctrl->payload.size() : 0;
+    strncpy(query.name, ctrl->name.data(), sizeof(query.name) - 1);
+    return 0;
+}
+
+auto FakeBackend::query_menu(v4l2_querymenu& querymenu) -> int {
+    const auto ctrl = find(querymenu.id);
+    if(ctrl == nullptr || ctrl->type != V4L2_CTRL_TYPE_MENU || querymenu.index > uint32_t(ctrl->max) || querymenu.index % config.menu_stride != 0) {
+        return fail(EINVAL);
+    }
+    snprintf((char*)querymenu.name, sizeof(querymenu.name), "Item %u", querymenu.index);
+    return 0;
+}
+
+auto FakeBackend::ext_controls(const unsigned long request, v4l2_ext_controls& ext_ctrls) -> int {
+    const auto to_request = ext_ctrls.which == V4L2_CTRL_WHICH_REQUEST_VAL;
+    if(to_request && (request != VIDIOC_S_EXT_CTRLS || !requests.contains(ext_ctrls.request_fd))) {
+        return fail(EINVAL);
+    }
+    // validate everything first, nothing is applied on failure
+    for(auto i = 0u; i < ext_ctrls.count; i += 1) {
+        auto&      ext  = ext_ctrls.controls[i];
+        const auto ctrl = find(ext.id);
+        if(ctrl == nullptr || (!to_request && ext_ctrls.ctrl_class != 0 && V4L2_CTRL_ID2CLASS(ext.id) != ext_ctrls.ctrl_class)) {
+            ext_ctrls.error_idx = request == VIDIOC_S_EXT_CTRLS ? ext_ctrls.count : i;
+            return fail(EINVAL);
+        }
+        if(!ctrl->payload.empty()) {
+            // the whole array is passed through ptr, a short buffer receives the needed size
+            if(ext.size < ctrl->payload.size()) {
+                ext.size            = ctrl->payload.size();
+                ext_ctrls.error_idx = request == VIDIOC_S_EXT_CTRLS ? ext_ctrls.count : i;
+                return fail(ENOSPC);
+            }
+            continue;
+        }
+        if(request != VIDIOC_G_EXT_CTRLS && (ext.value < ctrl->min || ext.value > ctrl->max || (ctrl->flags & V4L2_CTRL_FLAG_READ_ONLY))) {
+            ext_ctrls.error_idx = request == VIDIOC_S_EXT_CTRLS ? ext_ctrls.count : i;
+            return fail(ctrl->flags & V4L2_CTRL_FLAG_READ_ONLY ? EACCES : ERANGE);
+        }
+    }
+    for(auto i = 0u; i < ext_ctrls.count; i += 1) {
+        auto&      ext  = ext_ctrls.controls[i];
+        auto&      ctrl = *find(ext.id);
+        // empty unless compound
+        const auto data = std::span((std::byte*)ext.ptr, ctrl.payload.size());
+        if(to_request) {
+            requests[ext_ctrls.request_fd].values.push_back({ext.id, ext.value, {data.begin(), data.end()}});
+        } else if(request == VIDIOC_G_EXT_CTRLS) {
+            ext.value = ctrl.value;
+            std::ranges::copy(ctrl.payload, data.begin());
+        } else if(request == VIDIOC_S_EXT_CTRLS) {
+            ctrl.value = ext.value;
+            std::ranges::copy(data, ctrl.payload.begin());
+        }
+    }
+    return 0;
+}
+
+auto FakeBackend::media_request(const int fd, const unsigned long request) -> int {
+    const auto p = requests.find(fd);
+    if(p == requests.end()) {
+        return fail(ENOTTY);
+    }
+    auto& [peer, values] = p->second;
+    auto  byte           = char(0);
+    if(request == MEDIA_REQUEST_IOC_QUEUE) {
+        for(const auto& value : values) {
+            auto& ctrl = *find(value.id);
+            ctrl.value = value.value;
+            if(!value.payload.empty()) {
+                ctrl.payload = value.payload;
+            }
+        }
+        // completion is reported as POLLPRI, like the kernel does
+        if(send(peer, &byte, 1, MSG_OOB) != 1) {
+            return -1;
+        }
+    } else {
+        // the pending completion, if any
+        recv(fd, &byte, 1, MSG_OOB | MSG_DONTWAIT);
+    }
+    values.clear();
+    return 0;
+}
+
+auto FakeBackend::open(const char* const /*path*/, const int /*flags*/) -> int {
+    // a real fd, so that poll() works on it
+    return eventfd(0, EFD_CLOEXEC);
+}
+
+auto FakeBackend::close(const int fd) -> int {
+    {
+        auto       guard = std::lock_guard(lock);
+        const auto p     = requests.find(fd);
+        if(p != requests.end()) {
+            ::close(p->second.peer);
+            requests.erase(p);
+        }
+    }
+    return ::close(fd);
+}
+
+auto FakeBackend::ioctl(const int fd, const unsigned long request, void* const arg) -> int {
+    if(config.latency.count() > 0) {
+        std::this_thread::sleep_for(config.latency);
+    }
+
+    auto guard = std::lock_guard(lock);
+    switch(request) {
+    case VIDIOC_QUERYCAP: {
+        auto& cap = *(v4l2_capability*)arg;
+        cap       = v4l2_capability();
+        strcpy((char*)cap.driver, "fake");
+        strcpy((char*)cap.card, "Fake Device");
+        strcpy((char*)cap.bus_info, "platform:fake");
+        cap.version = 1;
+        return 0;
+    }
+    case VIDIOC_QUERYCTRL: {
+        auto& queryctrl = *(v4l2_queryctrl*)arg;
+        auto  ext       = v4l2_query_ext_ctrl();
+        ext.id          = queryctrl.id;
+        if(query(ext) != 0) {
+            return -1;
+        }
+        queryctrl = v4l2_queryctrl();
+        copy_query(ext, queryctrl);
+        return 0;
+    }
+    case VIDIOC_QUERY_EXT_CTRL:
+        return config.legacy ? fail(ENOTTY) : query(*(v4l2_query_ext_ctrl*)arg);
+    case VIDIOC_QUERYMENU:
+        return query_menu(*(v4l2_querymenu*)arg);
+    case VIDIOC_G_CTRL:
+    case VIDIOC_S_CTRL: {
+        auto&      control = *(v4l2_control*)arg;
+        const auto ctrl    = find(control.id);
+        if(ctrl == nullptr || !ctrl->payload.empty()) {
+            return fail(EINVAL);
+        }
+        if(request == VIDIOC_G_CTRL) {
+            control.value = ctrl->value;
+            return 0;
+        }
+        if(control.value < ctrl->min || control.value > ctrl->max) {
+            return fail(ERANGE);
+        }
+        ctrl->value = control.value;
+        return 0;
+    }
+    case VIDIOC_G_EXT_CTRLS:
+    case VIDIOC_S_EXT_CTRLS:
+    case VIDIOC_TRY_EXT_CTRLS:
+        return config.legacy ? fail(ENOTTY) : ext_controls(request, *(v4l2_ext_controls*)arg);
+    case VIDIOC_SUBSCRIBE_EVENT:
+        return 0;
+    case VIDIOC_DQEVENT:
+        return fail(ENOENT);
+    case MEDIA_IOC_REQUEST_ALLOC: {
+        int pair[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) == -1) {
+            return -1;
+        }
+        requests[pair[0]] = {.peer = pair[1], .values = {}};
+        *(int*)arg        = pair[0];
+        return 0;
+    }
+    case MEDIA_REQUEST_IOC_QUEUE:
+    case MEDIA_REQUEST_IOC_REINIT:
+        return media_request(fd, request);
+    default:
+        return fail(ENOTTY);
+    }
+}
+
+FakeBackend::FakeBackend(FakeConfig config_)
+    : config(std::move(config_)) {
+    config.menu_stride = std::max(config.menu_stride, 1u);
+    for(const auto control_class : config.classes) {
+        // class controls come first in each class, like real drivers
+        controls.push_back({control_class | 1, V4L2_CTRL_TYPE_CTRL_CLASS, "Class", 0, 0, 0, 0, V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_WRITE_ONLY});
+        for(auto i = 0u; i < config.controls_per_class; i += 1) {
+            const auto id = control_class | (0x900 + i);
+            switch(i % 3) {
+            case 0:
+                controls.push_back({id, V4L2_CTRL_TYPE_INTEGER, "Int " + std::to_string(id), -100, 1000, 1, 0, V4L2_CTRL_FLAG_SLIDER});
+                break;
+            case 1:
+                controls.push_back({id, V4L2_CTRL_TYPE_BOOLEAN, "Bool " + std::to_string(id), 0, 1, 1, 0, 0});
+                break;
+            case 2:
+                controls.push_back({id, V4L2_CTRL_TYPE_MENU, "Menu " + std::to_string(id), 0, int32_t(config.menu_size) - 1, 1, 0, 0});
+                break;
+            }
+        }
+        if(config.compound) {
+            const auto id = control_class | (0x900 + config.controls_per_class);
+            controls.push_back({id, V4L2_CTRL_TYPE_U8, "Array " + std::to_string(id), 0, 255, 1, 0, V4L2_CTRL_FLAG_HAS_PAYLOAD, std::vector<std::byte>(8)});
+        }
+    }
+    std::ranges::sort(controls, {}, &FakeControl::id);
+}
+} // namespace v4l2
@@ -0,0 +1,79 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <linux/videodev2.h>
+
+#include "v4l2.hpp"
+
+namespace v4l2 {
+struct FakeConfig {
+    // controls in each class, cycling through int, bool and menu
+    uint32_t              controls_per_class = 16;
+    std::vector<uint32_t> classes            = {V4L2_CTRL_CLASS_USER, V4L2_CTRL_CLASS_CAMERA};
+    // followed by a u8 array control in each class, only enumerated with V4L2_CTRL_FLAG_NEXT_COMPOUND
+    bool compound = true;
+    // menu controls span [0, menu_size), only every menu_stride-th index is valid
+    uint32_t menu_size   = 4;
+    uint32_t menu_stride = 1;
+    // slept on every ioctl, to simulate usb round trips
+    std::chrono::microseconds latency = {};
+    // reject VIDIOC_*_EXT_CTRL(S) like old drivers do
+    bool legacy = false;
+};
+
+// in-memory device answering control ioctls
+// every fd opened through it refers to the same device, media devices included
+// requests complete as soon as they are queued, no buffer is needed
+class FakeBackend : public Backend {
+  private:
+    struct FakeControl {
+        uint32_t    id;
+        uint32_t    type;
+        std::string name;
+        int32_t     min;
+        int32_t     max;
+        int32_t     step;
+        int32_t     value;
+        uint32_t    flags;
+        // value of compound controls, empty for the others
+        std::vector<std::byte> payload;
+    };
+
+    struct FakeValue {
+        uint32_t               id;
+        int32_t                value;
+        std::vector<std::byte> payload;
+    };
+
+    // the request fd is one end of a socket pair, so that completion can be reported as POLLPRI
+    // by sending out-of-band data from the other end
+    struct FakeRequest {
+        int                    peer;
+        std::vector<FakeValue> values;
+    };
+
+    FakeConfig               config;
+    std::vector<FakeControl> controls; // sorted by id
+    std::mutex               lock;
+    std::unordered_map<int, FakeRequest> requests; // keyed by request fd
+
+    auto find(uint32_t id) -> FakeControl*;
+    // like the kernel, compound controls are only returned with V4L2_CTRL_FLAG_NEXT_COMPOUND
+    // and the others only with V4L2_CTRL_FLAG_NEXT_CTRL
+    auto find_next(uint32_t id, bool next_ctrl, bool next_compound) -> FakeControl*;
+    auto query(v4l2_query_ext_ctrl& query) -> int;
+    auto query_menu(v4l2_querymenu& querymenu) -> int;
+    auto ext_controls(unsigned long request, v4l2_ext_controls& ext_ctrls) -> int;
+    auto media_request(int fd, unsigned long request) -> int;
+
+  public:
+    auto open(const char* path, int flags) -> int override;
+    auto close(int fd) -> int override;
+    auto ioctl(int fd, unsigned long request, void* arg) -> int override;
+
+    FakeBackend(FakeConfig config);
+};
+} // namespace v4l2
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cstdio>
+
+#include <time.h>
+
+#include "hud.hpp"
+
+namespace vcw {
+namespace {
+auto now_ns() -> uint64_t {
+    auto ts = timespec();
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+// "12.3us" or "1.23ms"
+auto format_duration(char* const buf, const size_t size, const uint64_t ns) -> int {
+    return ns < 1'000'000 ? snprintf(buf, size, "%.1fus", ns / 1e3) : snprintf(buf, size, "%.2fms", ns / 1e6);
+}
+} // namespace
+
+auto Samples::push(const uint64_t ns) -> void {
+    ring[head] = ns;
+    head       = (head + 1) % ring.size();
+    count      = std::min(count + 1, ring.size());
+}
+
+auto Samples::clear() -> void {
+    head  = 0;
+    count = 0;
+}
+
+auto Samples::get_average() const -> uint64_t {
+    auto sum = uint64_t(0);
+    for(auto i = 0u; i < count; i += 1) {
+        sum += ring[i];
+    }
+    return count != 0 ? sum / count : 0;
+}
+
+auto Samples::get_max() const -> uint64_t {
+    return count != 0 ? *std::max_element(ring.begin(), ring.begin() + count) : 0;
+}
+
+auto Hud::is_enabled() const -> bool {
+    return enabled;
+}
+
+auto Hud::toggle() -> void {
+    enabled  = !enabled;
+    input_ns = 0;
+    frames.clear();
+    rows.clear();
+    writes.clear();
+    row_writes.clear();
+}
+
+auto Hud::reset_rows(const ControlRows& control_rows) -> void {
+    std::erase_if(row_writes, [&control_rows](const auto& write) { return !control_rows.contains(write.first); });
+}
+
+auto Hud::now() const -> uint64_t {
+    return enabled ? now_ns() : 0;
+}
+
+auto Hud::mark_input() -> void {
+    input_ns = now();
+}
+
+auto Hud::get_input_time() const -> uint64_t {
+    return input_ns;
+}
+
+auto Hud::record_frame(const uint64_t ns) -> void {
+    frames.push(ns);
+}
+
+auto Hud::record_row(const uint64_t ns) -> void {
+    rows.push(ns);
+}
+
+auto Hud::record_write(const Control* const control, const uint64_t ns) -> void {
+    writes.push(ns);
+    if(control != nullptr) {
+        row_writes[control] = ns;
+    }
+}
+
+auto Hud::format_row_badge(const Control* const control) -> std::string_view {
+    const auto p = row_writes.find(control);
+    if(p == row_writes.end()) {
+        return {};
+    }
+    return {text, size_t(format_duration(text, sizeof(text), p->second))};
+}
+
+auto Hud::format_line(const size_t index) -> std::string_view {
+    const auto print_samples = [this](const char* const label, const Samples& samples) -> std::string_view {
+        auto len = snprintf(text, sizeof(text), "%s avg ", label);
+        len += format_duration(text + len, sizeof(text) - len, samples.get_average());
+        len += snprintf(text + len, sizeof(text) - len, " max ");
+        len += format_duration(text + len, sizeof(text) - len, samples.get_max());
+        return {text, size_t(len)};
+    };
+
+    switch(index) {
+    case 0:
+        return print_samples("frame", frames);
+    case 1:
+        return {text, size_t(snprintf(text, sizeof(text), "refreshes %zu", refreshes))};
+    case 2:
+        return print_samples("draw_row", rows);
+    case 3:
+        return print_samples("input to device", writes);
+    default:
+        return {};
+    }
+}
+} // namespace vcw
@@ -0,0 +1,62 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+namespace vcw {
+struct Control;
+
+// row index of each control in the rows
+using ControlRows = std::unordered_map<const Control*, size_t>;
+
+// fixed capacity history of durations, the oldest sample is overwritten
+class Samples {
+  private:
+    std::array<uint64_t, 128> ring  = {};
+    size_t                    head  = 0;
+    size_t                    count = 0;
+
+  public:
+    auto push(uint64_t ns) -> void;
+    auto clear() -> void;
+    auto get_average() const -> uint64_t;
+    auto get_max() const -> uint64_t;
+};
+
+// timings shown by the performance overlay
+// they are collected only while it is shown, and nothing is allocated while it is hidden
+class Hud {
+  private:
+    bool                                         enabled  = false;
+    uint64_t                                     input_ns = 0;
+    Samples                                      frames;
+    Samples                                      rows;
+    Samples                                      writes;     // from input to ioctl completion
+    std::unordered_map<const Control*, uint64_t> row_writes; // latest write of each shown control
+    char                                         text[64];
+
+  public:
+    size_t refreshes = 0; // counted even while hidden
+
+    auto is_enabled() const -> bool;
+    auto toggle() -> void;
+    // rows were replaced, writes of controls still shown are kept
+    // the others are dropped, as their controls may have been freed
+    auto reset_rows(const ControlRows& control_rows) -> void;
+    // monotonic time, or 0 while hidden so that timing costs nothing
+    auto now() const -> uint64_t;
+    auto mark_input() -> void;
+    // time of the input being handled, 0 while hidden
+    auto get_input_time() const -> uint64_t;
+    auto record_frame(uint64_t ns) -> void;
+    auto record_row(uint64_t ns) -> void;
+    // control is null if it is not shown
+    auto record_write(const Control* control, uint64_t ns) -> void;
+    // the following return views valid until the next call
+    // empty if the control has no write
+    auto format_row_badge(const Control* control) -> std::string_view;
+    // empty after the last line
+    auto format_line(size_t index) -> std::string_view;
+};
+} // namespace vcw
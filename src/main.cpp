@@ -1,98 +1,568 @@
-#include <fcntl.h>
+#include <algorithm>
+#include <filesystem>
 
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "cache.hpp"
+#include "control-table.hpp"
+#include "coop/io.hpp"
+#include "coop/thread.hpp"
 #include "gawl/wayland/application.hpp"
 #include "macros/assert.hpp"
-#include "v4l2.hpp"
+#include "publisher.hpp"
+#include "ramp.hpp"
+#include "startup.hpp"
+#include "stats.hpp"
+#include "value-text.hpp"
 #include "window.hpp"
+#include "writer.hpp"
+
+struct Device;
 
+// duration of ramps started from the window
+constexpr auto ramp_duration_ns = uint64_t(500'000'000);
+
+// view of one row of the device control table
 struct Control : vcw::Control {
-    v4l2::Control ctrl;
+    Device*     device;
+    size_t      index;
+    std::string text; // reused by get_text()
+
+    auto get_table() const -> v4l2::ControlTable&;
 
     auto is_active() -> bool override {
-        return !ctrl.ro && !ctrl.inactive;
+        return get_table().is_active(index);
     }
 
     auto get_type() -> vcw::ControlType override {
-        switch(ctrl.type) {
+        switch(get_table().types[index]) {
         case v4l2::ControlType::Int:
             return vcw::ControlType::Int;
         case v4l2::ControlType::Bool:
             return vcw::ControlType::Bool;
         case v4l2::ControlType::Menu:
+        case v4l2::ControlType::IntMenu:
             return vcw::ControlType::Menu;
+        case v4l2::ControlType::Bitmask:
+        case v4l2::ControlType::Int64:
+        case v4l2::ControlType::Payload:
+            return vcw::ControlType::Text;
         }
     }
 
     auto get_label() -> std::string_view override {
-        return ctrl.name;
+        return get_table().get_name(index);
     }
 
     auto get_range() -> vcw::ValueRange override {
-        return {ctrl.min, ctrl.max, ctrl.step};
+        const auto& table = get_table();
+        return {table.mins[index], table.maxs[index], table.steps[index]};
     }
 
     auto get_current() -> int override {
-        return ctrl.current;
+        return get_table().currents[index];
     }
 
     auto get_menu_size() -> size_t override {
-        return ctrl.menus.size();
+        return get_table().get_menu_size(index);
     }
 
-    auto get_menu_label(const size_t index) -> std::string_view override {
-        return ctrl.menus[index].name;
+    auto get_menu_label(const size_t menu) -> std::string_view override {
+        return get_table().get_menu_label(index, menu);
     }
 
-    auto get_menu_value(const size_t index) -> int override {
-        return int(ctrl.menus[index].index);
+    auto get_menu_value(const size_t menu) -> int override {
+        return get_table().get_menu_value(index, menu);
     }
-};
 
-auto controls_to_rows(std::vector<v4l2::Control> controls) -> std::vector<vcw::Row> {
-    auto ret = std::vector<vcw::Row>();
-    for(auto& ctrl : controls) {
-        if(ctrl.type == v4l2::ControlType::Menu) {
-            ret.emplace_back(vcw::Row::create<vcw::Label>(ctrl.name));
+    auto get_text() -> std::string_view override {
+        // payloads can be large, only their head is shown
+        constexpr auto max_elements = size_t(16);
+
+        auto& table = get_table();
+        text.clear();
+        if(v4l2::has_payload(table.types[index])) {
+            v4l2::format_payload(table.get_payload(index), text, max_elements);
+        } else {
+            v4l2::format_value(table.types[index], table.currents[index], text);
         }
-        const auto ptr = new Control();
-        ptr->ctrl      = std::move(ctrl);
-        ret.emplace_back(vcw::Row::create<vcw::ControlPtr>(ptr));
+        return text;
+    }
+
+    Control(Device* const device, const size_t index)
+        : device(device),
+          index(index) {
     }
-    ret.emplace_back(vcw::Row::create<vcw::QuitButton>());
+};
+
+// result of the blocking part of loading a device, done off the ui thread
+struct DeviceDescription {
+    int                        fd;
+    std::string                card;
+    std::vector<v4l2::Control> controls;
+};
 
+auto describe_device(const std::string& path) -> std::optional<DeviceDescription> {
+    const auto fd = v4l2::open_device(path.data());
+    ensure(fd >= 0);
+    auto ret = DeviceDescription{.fd = fd, .card = {}, .controls = {}};
+    if(const auto identity = v4l2::query_identity(fd)) {
+        ret.card = identity->card;
+    }
+    ret.controls = v4l2::query_controls_cached(fd);
     return ret;
 }
 
+// controls are loaded the first time the device is viewed
+struct Device {
+    std::string        path;
+    std::string        card;
+    int                fd        = -1;
+    int                cancel_fd = -1;
+    v4l2::ControlTable table;
+    // parallel to table, rebuilt only when table is reassigned
+    std::vector<Control>             controls;
+    std::unique_ptr<v4l2::Writer>    writer;
+    std::unique_ptr<v4l2::Publisher> publisher;
+    v4l2::Ramps                      ramps;
+    bool                             running = true;
+    bool                             loading = false;
+    bool                             removed = false; // unplugged, the fd no longer answers
+
+    auto is_loaded() const -> bool {
+        return fd != -1;
+    }
+
+    auto load(DeviceDescription description) -> void {
+        fd   = description.fd;
+        card = std::move(description.card);
+        table.assign(fd, description.controls);
+        controls.clear();
+        controls.reserve(table.size());
+        for(auto i = 0u; i < table.size(); i += 1) {
+            controls.emplace_back(this, i);
+            // payloads are read when their initial events arrive
+            if(!v4l2::subscribe_control_events(fd, table.ids[i])) {
+                line_warn("failed to subscribe control events");
+            }
+        }
+        cancel_fd = eventfd(0, EFD_CLOEXEC);
+        writer.reset(new v4l2::Writer(fd));
+        publisher.reset(new v4l2::Publisher(path, table));
+    }
+
+    // values changed by this process, events are published by watch_controls
+    auto set_current(const size_t index, const int32_t value) -> void {
+        table.currents[index] = value;
+        publisher->publish(table, index);
+    }
+
+    // finishes watcher tasks
+    auto stop() -> void {
+        running = false;
+        if(is_loaded()) {
+            eventfd_write(cancel_fd, 1);
+            eventfd_write(writer->get_done_fd(), 1);
+            ramps.interrupt();
+        }
+    }
+
+    Device(std::string path)
+        : path(std::move(path)) {
+    }
+
+    ~Device() {
+        if(is_loaded()) {
+            writer.reset();
+            if(!removed && !v4l2::save_menu_cache(fd, table)) {
+                line_warn("failed to write menu cache");
+            }
+            close(cancel_fd);
+            v4l2::close_device(fd);
+        }
+    }
+};
+
+auto Control::get_table() const -> v4l2::ControlTable& {
+    return device->table;
+}
+
+auto wait_readable(const int fd, const int cancel_fd) -> bool {
+    auto fds = std::array{
+        pollfd{.fd = fd, .events = POLLIN, .revents = 0},
+        pollfd{.fd = cancel_fd, .events = POLLIN, .revents = 0},
+    };
+    while(poll(fds.data(), fds.size(), -1) == -1) {
+        if(errno != EINTR) {
+            return false;
+        }
+    }
+    return fds[1].revents == 0 && fds[0].revents & POLLIN;
+}
+
 struct UserCallbacks : public vcw::UserCallbacks {
-    int                    fd;
-    std::vector<vcw::Row>* rows;
+    std::vector<std::shared_ptr<Device>> devices;
+    size_t                               selected = 0;
+    // paths given on command line, empty to manage every /dev/video*
+    std::vector<std::string> explicit_paths;
+    std::vector<vcw::Row>*   rows;
+    vcw::Callbacks*          window;
+    coop::Runner*            runner;
+    int                      cancel_fd;
+
+    auto is_selected(const std::shared_ptr<Device>& device) const -> bool {
+        return selected < devices.size() && devices[selected] == device;
+    }
+
+    auto build_rows() -> void;
+    auto select_tab(size_t index) -> void override;
+    auto add_device(std::string path) -> void;
+    auto remove_device(std::string_view path) -> void;
 
     auto set_control_value(vcw::Control& control, int value) -> void override {
-        auto& ctrl   = std::bit_cast<Control*>(&control)->ctrl;
-        ctrl.current = value;
-        v4l2::set_control(fd, ctrl.id, ctrl.current);
-        if(ctrl.type == v4l2::ControlType::Bool || ctrl.type == v4l2::ControlType::Menu) {
-            // reload for newly activated/inactivated controls;
-            *rows = controls_to_rows(v4l2::query_controls(fd));
+        // update ui immediately, the device catches up in background
+        const auto& ctrl   = *std::bit_cast<Control*>(&control);
+        auto&       device = *ctrl.device;
+        const auto  id     = device.table.ids[ctrl.index];
+        device.ramps.cancel(id);
+        // clamped and quantized, no-op writes never leave the process
+        if(const auto clamped = device.table.prepare_write(ctrl.index, value)) {
+            device.publisher->publish(device.table, ctrl.index);
+            device.writer->write(id, *clamped, window->get_input_time());
         }
+        // newly activated/inactivated controls are reported by control events
+    }
+
+    auto ramp_control_value(vcw::Control& control, const int value) -> void override {
+        const auto& ctrl  = *std::bit_cast<Control*>(&control);
+        auto&       table = ctrl.get_table();
+
+        const auto i = ctrl.index;
+        ctrl.device->ramps.start(table.ids[i], table.currents[i], value, table.mins[i], table.steps[i], ramp_duration_ns, v4l2::Ramps::Curve::Smooth);
+    }
+
+    auto quit() -> bool override {
+        for(const auto& device : devices) {
+            device->stop();
+        }
+        eventfd_write(cancel_fd, 1);
+        return true;
     }
 };
 
-auto main(const int argc, const char* argv[]) -> int {
-    ensure(argc == 2);
+// reverts rows whose writes were rejected by the device
+auto watch_writes(const std::shared_ptr<Device> device, UserCallbacks& user) -> coop::Async<void> {
+    while(true) {
+        co_await coop::wait_for_file(device->writer->get_done_fd(), true, false);
+        if(!device->running) {
+            co_return;
+        }
+        const auto selected = user.is_selected(device);
+        for(const auto& result : device->writer->take_results()) {
+            const auto index = device->table.find(result.id);
+            if(!index) {
+                continue;
+            }
+            if(!result.ok) {
+                // a ramp would keep hitting the same error on every tick
+                device->ramps.cancel(result.id);
+                device->set_current(*index, result.value);
+                if(selected) {
+                    user.window->notify_control_changed(device->controls[*index]);
+                }
+            } else if(result.input_ns != 0 && selected) {
+                user.window->notify_control_written(device->controls[*index], result.done_ns - result.input_ns);
+            }
+        }
+    }
+}
 
-    const auto fd = open(argv[1], O_RDWR);
-    ensure(fd >= 0);
-    auto rows = controls_to_rows(v4l2::query_controls(fd));
+// advances running ramps of the device, values of one tick are written in one batch
+auto watch_ramps(const std::shared_ptr<Device> device, UserCallbacks& user) -> coop::Async<void> {
+    auto values = std::vector<v4l2::ControlValue>();
+    auto writes = std::vector<v4l2::ControlValue>();
+    while(true) {
+        co_await coop::wait_for_file(device->ramps.get_timer_fd(), true, false);
+        if(!device->running) {
+            co_return;
+        }
+        values.clear();
+        device->ramps.tick(values);
+        // clamped and recorded through the table like any other write
+        writes.clear();
+        const auto selected = user.is_selected(device);
+        for(const auto& value : values) {
+            const auto index = device->table.find(value.id);
+            if(!index) {
+                continue;
+            }
+            if(const auto clamped = device->table.prepare_write(*index, value.value)) {
+                writes.push_back({value.id, *clamped});
+                device->publisher->publish(device->table, *index);
+                if(selected) {
+                    user.window->notify_control_changed(device->controls[*index]);
+                }
+            }
+        }
+        if(!writes.empty()) {
+            device->writer->write_batch(writes);
+        }
+    }
+}
+
+// patches rows in place as the device reports value, flag and range changes,
+// including ones made by other processes
+auto watch_controls(const std::shared_ptr<Device> device, UserCallbacks& user) -> coop::Async<void> {
+    struct Change {
+        v4l2::ControlEvent           event;
+        std::optional<v4l2::Payload> payload; // events do not carry payloads, they are read along with the event
+    };
+
+    const auto fd        = device->fd;
+    const auto cancel_fd = device->cancel_fd;
+    auto&      table     = device->table;
+    auto       changes   = std::vector<Change>();
+    // events are dequeued and payloads are read off the window thread, a compound read can take a while
+    // only ids, types and layouts of the table are touched there, they do not change after loading
+    const auto receive = [fd, cancel_fd, &table, &changes] {
+        changes.clear();
+        if(!v4l2::wait_events(fd, cancel_fd)) {
+            return false;
+        }
+        while(const auto event = v4l2::dequeue_event(fd)) {
+            auto&      change = changes.emplace_back(Change{*event, std::nullopt});
+            const auto index  = table.find(event->id);
+            if(!index || !(event->changes & V4L2_EVENT_CTRL_CH_VALUE) || !v4l2::has_payload(table.types[*index])) {
+                continue;
+            }
+            auto& payload = change.payload.emplace(v4l2::make_payload(event->id, table.get_payload(*index).layout));
+            if(!v4l2::get_payload(fd, payload)) {
+                // the table keeps the old value rather than reading on the window thread
+                change.payload.reset();
+                change.event.changes &= ~V4L2_EVENT_CTRL_CH_VALUE;
+            }
+        }
+        return true;
+    };
+    while(co_await coop::run_blocking(receive)) {
+        const auto selected = user.is_selected(device);
+        for(const auto& [event, payload] : changes) {
+            // our own writes are reported back as well
+            // the echo of an older value would move a dragged slider back, the newest one is going to be reported anyway
+            if(event.changes == V4L2_EVENT_CTRL_CH_VALUE && device->writer->is_writing(event.id)) {
+                continue;
+            }
+            const auto index = table.apply_event(event, payload ? &*payload : nullptr);
+            if(!index) {
+                continue;
+            }
+            device->publisher->publish(device->table, *index);
+            if(selected) {
+                user.window->notify_control_changed(device->controls[*index]);
+            }
+        }
+    }
+}
 
-    auto user_callbacks  = std::shared_ptr<UserCallbacks>(new UserCallbacks());
-    user_callbacks->fd   = fd;
-    user_callbacks->rows = &rows;
+// opens and enumerates the device without blocking the window, which shows a placeholder meanwhile
+auto load_device(const std::shared_ptr<Device> device, UserCallbacks& user) -> coop::Async<void> {
+    auto description = co_await coop::run_blocking([path = device->path] { return describe_device(path); });
+    device->loading  = false;
+    if(!device->running) {
+        if(description) {
+            v4l2::close_device(description->fd);
+        }
+        co_return;
+    }
+    if(!description) {
+        line_warn("failed to open device");
+    } else {
+        device->load(std::move(*description));
+        startup::mark("controls loaded");
+        user.runner->push_task(watch_controls(device, user), watch_writes(device, user), watch_ramps(device, user));
+    }
+    user.build_rows();
+}
 
+// follows /dev/video* creation and removal
+auto watch_hotplug(const int inotify_fd, UserCallbacks& user) -> coop::Async<void> {
+    const auto cancel_fd = user.cancel_fd;
+    while(co_await coop::run_blocking([inotify_fd, cancel_fd] { return wait_readable(inotify_fd, cancel_fd); })) {
+        alignas(inotify_event) char buf[4096];
+        const auto                  len = read(inotify_fd, buf, sizeof(buf));
+        for(auto ptr = buf; ptr < buf + len;) {
+            const auto& event = *(inotify_event*)ptr;
+            ptr += sizeof(inotify_event) + event.len;
+            if(event.len == 0 || !std::string_view(event.name).starts_with("video")) {
+                continue;
+            }
+            auto path = std::string("/dev/") + event.name;
+            if(event.mask & IN_CREATE) {
+                user.add_device(std::move(path));
+            } else if(event.mask & IN_DELETE) {
+                user.remove_device(path);
+            }
+        }
+    }
+}
+
+auto UserCallbacks::build_rows() -> void {
+    rows->clear();
+    for(auto i = 0u; i < devices.size(); i += 1) {
+        const auto& device = *devices[i];
+        rows->emplace_back(vcw::Row::create<vcw::Tab>(vcw::Tab{device.card.empty() ? device.path : device.path + " " + device.card, i, i == selected}));
+    }
+    if(selected < devices.size()) {
+        auto& device = *devices[selected];
+        if(!device.is_loaded()) {
+            rows->emplace_back(vcw::Row::create<vcw::Label>(std::string(device.loading ? "loading..." : "failed to open device")));
+        }
+        for(auto& ctrl : device.controls) {
+            if(v4l2::is_menu(device.table.types[ctrl.index])) {
+                rows->emplace_back(vcw::Row::create<vcw::Label>(std::string(device.table.get_name(ctrl.index))));
+            }
+            rows->emplace_back(vcw::Row::create<vcw::ControlPtr>(&ctrl));
+        }
+    }
+    rows->emplace_back(vcw::Row::create<vcw::QuitButton>());
+    window->notify_rows_replaced();
+}
+
+auto UserCallbacks::select_tab(const size_t index) -> void {
+    selected     = index;
+    auto& device = devices[index];
+    if(!device->is_loaded() && !device->loading) {
+        device->loading = true;
+        runner->push_task(load_device(device, *this));
+    }
+    build_rows();
+}
+
+auto UserCallbacks::add_device(std::string path) -> void {
+    if(!explicit_paths.empty() && std::ranges::find(explicit_paths, path) == explicit_paths.end()) {
+        return;
+    }
+    if(std::ranges::find(devices, path, [](const auto& device) { return device->path; }) != devices.end()) {
+        return;
+    }
+    devices.emplace_back(new Device(std::move(path)));
+    build_rows();
+}
+
+auto UserCallbacks::remove_device(const std::string_view path) -> void {
+    const auto p = std::ranges::find(devices, path, [](const auto& device) { return std::string_view(device->path); });
+    if(p == devices.end()) {
+        return;
+    }
+    // watcher tasks keep the device alive until they finish
+    (*p)->removed = true;
+    (*p)->stop();
+    const auto index = size_t(p - devices.begin());
+    devices.erase(p);
+    if(selected > index || selected == devices.size()) {
+        selected = selected > 0 ? selected - 1 : 0;
+    }
+    if(devices.empty()) {
+        build_rows();
+    } else {
+        // the newly selected device may not be loaded yet
+        select_tab(selected);
+    }
+}
+
+auto main(const int argc, const char* argv[]) -> int {
+    startup::mark("main");
+    auto paths = std::vector<std::string>();
+    auto stats = std::string_view();
+    for(auto i = 1; i < argc; i += 1) {
+        const auto arg = std::string_view(argv[i]);
+        if(arg == "--stats" || arg == "--stats=json") {
+            stats = arg;
+        } else {
+            ensure(!arg.starts_with("-"), "usage: v4l2-wlctl [--stats[=json]] [DEVICE]...");
+            paths.emplace_back(arg);
+        }
+    }
+    const auto scan_all = paths.empty();
+    if(scan_all) {
+        // no devices are opened here, enumeration is deferred until selected
+        auto error = std::error_code();
+        for(const auto& entry : std::filesystem::directory_iterator("/dev", error)) {
+            if(entry.path().filename().string().starts_with("video")) {
+                paths.emplace_back(entry.path().string());
+            }
+        }
+        std::ranges::sort(paths);
+    }
+    startup::mark("devices listed");
+
+    const auto cancel_fd  = eventfd(0, EFD_CLOEXEC);
+    const auto inotify_fd = inotify_init1(IN_CLOEXEC);
+    ensure(cancel_fd >= 0 && inotify_fd >= 0);
+    ensure(inotify_add_watch(inotify_fd, "/dev", IN_CREATE | IN_DELETE) >= 0);
+
+    auto rows   = std::vector<vcw::Row>();
     auto runner = coop::Runner();
-    auto app    = gawl::WaylandApplication();
-    auto cbs    = std::shared_ptr<vcw::Callbacks>(new vcw::Callbacks(rows, user_callbacks));
-    runner.push_task(app.run(), app.open_window({.title = "v4l2-wlctl", .manual_refresh = true}, std::move(cbs)));
+
+    auto user_callbacks       = std::shared_ptr<UserCallbacks>(new UserCallbacks());
+    user_callbacks->rows      = &rows;
+    user_callbacks->runner    = &runner;
+    user_callbacks->cancel_fd = cancel_fd;
+    if(!scan_all) {
+        user_callbacks->explicit_paths = paths;
+    }
+
+    auto app = gawl::WaylandApplication();
+    auto cbs = std::shared_ptr<vcw::Callbacks>(new vcw::Callbacks(rows, user_callbacks));
+
+    user_callbacks->window = cbs.get();
+    for(auto& path : paths) {
+        user_callbacks->devices.emplace_back(new Device(std::move(path)));
+    }
+    if(!user_callbacks->devices.empty()) {
+        user_callbacks->select_tab(0);
+    } else {
+        user_callbacks->build_rows();
+    }
+
+    runner.push_task(app.run(), app.open_window({.title = "v4l2-wlctl", .manual_refresh = true}, cbs), watch_hotplug(inotify_fd, *user_callbacks));
     runner.run();
+
+    if(!stats.empty()) {
+        const auto  json       = stats == "--stats=json";
+        const auto& text_cache = cbs->get_text_cache();
+        // a single object in json
+        const auto separator = json ? "," : "";
+        fprintf(stderr, "%s", json ? "{" : "");
+        startup::print(stderr, json);
+        fprintf(stderr, "%s", separator);
+        v4l2::print_ioctl_stats(stderr, json);
+        fprintf(stderr, "%s", json ? ",\"devices\":[" : "");
+        auto first = true;
+        for(const auto& device : user_callbacks->devices) {
+            if(!device->is_loaded()) {
+                continue;
+            }
+            if(json) {
+                fprintf(stderr, "%s{\"device\":\"%s\",", first ? "" : ",", device->path.data());
+            } else {
+                fprintf(stderr, "%s:\n", device->path.data());
+            }
+            first = false;
+            device->ramps.print_stats(stderr, json);
+            fprintf(stderr, "%s", separator);
+            device->table.print_write_stats(stderr, json);
+            fprintf(stderr, "%s", json ? "}" : "");
+        }
+        if(json) {
+            fprintf(stderr, "],\"text_cache\":{\"hits\":%zu,\"misses\":%zu}}\n", text_cache.hits, text_cache.misses);
+        } else {
+            fprintf(stderr, "text cache: %zu hits, %zu misses\n", text_cache.hits, text_cache.misses);
+        }
+    }
     return 0;
 }
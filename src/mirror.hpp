@@ -0,0 +1,139 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// control values published by v4l2-wlctl and v4l2-wlctl-daemon for other local processes
+// this header has no other dependencies, readers can copy it as is
+//
+// the region is the posix shared memory object "/v4l2-wlctl-<device>", e.g. "/v4l2-wlctl-video0"
+// it holds a Header followed by Header::count Entries, ordered by control id
+// entries are guarded by one seqlock: the sequence is odd while the publisher is writing
+// reading takes no syscalls and no locks
+// one process publishes a device at a time, others opening it run without a mirror
+namespace mirror {
+constexpr auto magic   = uint32_t(0x6d6c7776); // "vwlm"
+constexpr auto version = uint32_t(2);
+
+enum Flags : uint32_t {
+    ReadOnly  = 1 << 0,
+    WriteOnly = 1 << 1,
+    Inactive  = 1 << 2,
+    Volatile  = 1 << 3,
+    Execute   = 1 << 4, // execute on write
+    NoValue   = 1 << 5, // 64-bit or compound, value is 0 and has to be read from the device
+};
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t pid; // of the publisher
+    uint64_t sequence;
+};
+
+struct Entry {
+    uint32_t id;
+    uint32_t flags;
+    int32_t  value;
+    int32_t  min;
+    int32_t  max;
+    int32_t  step;
+    char     name[32];
+};
+
+inline auto get_entries(const Header* const header) -> const Entry* {
+    return (const Entry*)(header + 1);
+}
+
+// changes whenever any entry changes
+inline auto get_generation(const Header* const header) -> uint64_t {
+    return std::atomic_ref(const_cast<uint64_t&>(header->sequence)).load(std::memory_order_acquire) / 2;
+}
+
+// whether the process which created the mirror still exists
+inline auto is_publisher_alive(const Header* const header) -> bool {
+    return kill(pid_t(header->pid), 0) == 0 || errno == EPERM;
+}
+
+// copies a consistent snapshot of the entry at index, returns its generation
+// returns nullopt if the publisher stays in the middle of a write, e.g. it died while writing
+inline auto read_entry(const Header* const header, const size_t index, Entry& out) -> std::optional<uint64_t> {
+    constexpr auto max_retries = 1 << 20;
+
+    auto&      sequence = const_cast<uint64_t&>(header->sequence);
+    const auto src      = const_cast<Entry*>(get_entries(header) + index);
+    for(auto retry = 0; retry < max_retries; retry += 1) {
+        const auto begin = std::atomic_ref(sequence).load(std::memory_order_acquire);
+        if(begin & 1) {
+            continue;
+        }
+        out.id    = std::atomic_ref(src->id).load(std::memory_order_relaxed);
+        out.flags = std::atomic_ref(src->flags).load(std::memory_order_relaxed);
+        out.value = std::atomic_ref(src->value).load(std::memory_order_relaxed);
+        out.min   = std::atomic_ref(src->min).load(std::memory_order_relaxed);
+        out.max   = std::atomic_ref(src->max).load(std::memory_order_relaxed);
+        out.step  = std::atomic_ref(src->step).load(std::memory_order_relaxed);
+        memcpy(out.name, src->name, sizeof(out.name)); // written only before the first publish
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(std::atomic_ref(sequence).load(std::memory_order_relaxed) == begin) {
+            return begin / 2;
+        }
+    }
+    return std::nullopt;
+}
+
+// returns the index of the control, or count
+inline auto find_entry(const Header* const header, const uint32_t id) -> size_t {
+    const auto entries = get_entries(header);
+    auto       lo      = size_t(0);
+    auto       hi      = size_t(header->count);
+    while(lo < hi) {
+        const auto mid = (lo + hi) / 2;
+        if(entries[mid].id < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < header->count && entries[lo].id == id ? lo : header->count;
+}
+
+inline auto get_shm_name(const std::string_view device) -> std::string {
+    return "/v4l2-wlctl-" + std::string(device.substr(device.rfind('/') + 1));
+}
+
+// maps the mirror of device read-only, unmap with munmap(header, get_size(header))
+inline auto map(const std::string_view device) -> const Header* {
+    const auto fd = shm_open(get_shm_name(device).data(), O_RDONLY | O_CLOEXEC, 0);
+    if(fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    const auto  size = fstat(fd, &st) == 0 ? size_t(st.st_size) : 0;
+    const auto  ptr  = size >= sizeof(Header) ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(ptr == MAP_FAILED) {
+        return nullptr;
+    }
+    const auto header = (const Header*)ptr;
+    if(header->magic != magic || header->version != version || size < sizeof(Header) + sizeof(Entry) * header->count) {
+        munmap(ptr, size);
+        return nullptr;
+    }
+    return header;
+}
+
+inline auto get_size(const Header* const header) -> size_t {
+    return sizeof(Header) + sizeof(Entry) * header->count;
+}
+} // namespace mirror
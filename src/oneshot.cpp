@@ -1,30 +1,645 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <thread>
+
 #include <fcntl.h>
+#include <glob.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
 
+#include "cache.hpp"
+#include "control-table.hpp"
 #include "macros/unwrap.hpp"
+#include "profile.hpp"
+#include "protocol.hpp"
+#include "ramp.hpp"
+#include "request.hpp"
+#include "script.hpp"
+#include "startup.hpp"
+#include "stats.hpp"
 #include "util/charconv.hpp"
-#include "v4l2.hpp"
+#include "value-text.hpp"
 
 namespace {
-auto run(const int argc, const char* argv[]) -> bool {
-    ensure(argc >= 4);
+enum class Mode {
+    Set,
+    Snapshot,
+    Restore,
+    Script,
+    Watch,
+};
+
+enum class StatsFormat {
+    None,
+    Text,
+    Json,
+};
+
+// NAME VALUE pair of the command line
+// the value itself depends on the control type, and is parsed per device
+struct Assignment {
+    const char*             name;
+    const char*             arg;      // as given
+    std::string_view        target;   // arg without @DURATION
+    std::optional<uint64_t> duration; // ramps if set
+};
+
+struct Args {
+    Mode                     mode  = Mode::Set;
+    StatsFormat              stats = StatsFormat::None;
+    const char*              device;
+    const char*              profile;
+    const char*              script;
+    const char*              socket = nullptr; // of the daemon, the default path if null
+    std::vector<Assignment>  pairs;
+    std::vector<const char*> names;
+    std::vector<std::string> devices; // expanded device for Set and Restore
+    size_t                   jobs    = 8;
+    bool                     daemon  = false;
+    bool                     request = false;
+};
+
+// statistics of one device, printed to stderr on exit after the process wide ones
+// marks of concurrent workers do not interleave in the process wide timeline
+struct DeviceStats {
+    startup::Timeline timeline;
+    FILE*             file; // json members each preceded by ',', as they are appended to the object of the device
+};
+
+auto print_usage() -> void {
+    printf("usage: v4l2-wlctl-oneshot [--daemon [--socket PATH]|--request] [--jobs N] DEVICE NAME VALUE [NAME VALUE]...\n");
+    printf("       v4l2-wlctl-oneshot --snapshot PROFILE DEVICE\n");
+    printf("       v4l2-wlctl-oneshot [--jobs N] --restore PROFILE DEVICE\n");
+    printf("       v4l2-wlctl-oneshot --script FILE DEVICE\n");
+    printf("       v4l2-wlctl-oneshot --watch DEVICE [NAME]...\n");
+    printf("  VALUE       a number, or TARGET@DURATION such as 100@500ms to ramp from the current value\n");
+    printf("              bitmasks also take 0x-prefixed hex, 64-bit controls take any 64-bit number\n");
+    printf("              arrays take elements separated by ',' such as 1,2,3, strings are taken as is\n");
+    printf("              other compound elements are 0x-prefixed bytes in memory order such as 0x0a000000\n");
+    printf("  DEVICE      a path, a glob pattern or a comma separated list of them\n");
+    printf("              set and restore run on every matching device, other modes take a single path\n");
+    printf("  --daemon    send the values to v4l2-wlctl-daemon instead of opening DEVICE\n");
+    printf("  --socket    socket of the daemon, default $XDG_RUNTIME_DIR/v4l2-wlctl.sock\n");
+    printf("  --request   apply the values through a media request and wait for its completion\n");
+    printf("  --jobs      number of devices processed concurrently, default 8\n");
+    printf("  --snapshot  save writable control values to PROFILE\n");
+    printf("  --restore   write the controls that differ from PROFILE\n");
+    printf("  --script    execute get/set/batch/dump commands from FILE, '-' for stdin\n");
+    printf("  --watch     print a json line per change of the named controls, or of every control\n");
+    printf("  --stats[=json]\n");
+    printf("              print ioctl statistics to stderr on exit\n");
+}
+
+// splits arg by ',' and expands glob patterns
+// patterns without matches are kept as is, so that opening them reports the error
+auto expand_devices(std::string_view arg) -> std::vector<std::string> {
+    auto ret = std::vector<std::string>();
+    while(!arg.empty()) {
+        const auto pos     = arg.find(',');
+        const auto pattern = std::string(arg.substr(0, pos));
+        arg                = pos == arg.npos ? std::string_view() : arg.substr(pos + 1);
+        if(pattern.empty()) {
+            continue;
+        }
+        auto matches = glob_t();
+        if(glob(pattern.data(), GLOB_NOCHECK, nullptr, &matches) == 0) {
+            ret.insert(ret.end(), matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+        }
+        globfree(&matches);
+    }
+    return ret;
+}
+
+// "500ms" or "2s"
+auto parse_duration(std::string_view str) -> std::optional<uint64_t> {
+    auto scale = uint64_t(1'000'000'000);
+    if(str.ends_with("ms")) {
+        scale = 1'000'000;
+        str.remove_suffix(2);
+    } else {
+        ensure(str.ends_with('s'));
+        str.remove_suffix(1);
+    }
+    unwrap(count, from_chars<uint64_t>(str));
+    return count * scale;
+}
+
+// TARGET@DURATION ramps from the current value
+auto parse_assignment(const char* const name, const char* const arg) -> std::optional<Assignment> {
+    const auto str = std::string_view(arg);
+    const auto at  = str.find('@');
+    auto       ret = Assignment{.name = name, .arg = arg, .target = str.substr(0, at), .duration = std::nullopt};
+    if(at != str.npos) {
+        unwrap(duration, parse_duration(str.substr(at + 1)), "invalid duration");
+        ret.duration = duration;
+    }
+    return ret;
+}
+
+auto parse_args(const int argc, const char* argv[]) -> std::optional<Args> {
+    auto ret = Args();
+    auto arg = 1;
+    for(; arg < argc && argv[arg][0] == '-'; arg += 1) {
+        const auto opt = std::string_view(argv[arg]);
+        if(opt == "--daemon") {
+            ret.daemon = true;
+        } else if(opt == "--socket") {
+            ensure(arg + 1 < argc);
+            ret.socket = argv[arg += 1];
+        } else if(opt == "--request") {
+            ret.request = true;
+        } else if(opt == "--stats" || opt == "--stats=json") {
+            ret.stats = opt == "--stats" ? StatsFormat::Text : StatsFormat::Json;
+        } else if(opt == "--snapshot" || opt == "--restore") {
+            ensure(arg + 1 < argc);
+            ret.mode    = opt == "--snapshot" ? Mode::Snapshot : Mode::Restore;
+            ret.profile = argv[arg += 1];
+        } else if(opt == "--script") {
+            ensure(arg + 1 < argc);
+            ret.mode   = Mode::Script;
+            ret.script = argv[arg += 1];
+        } else if(opt == "--watch") {
+            ret.mode = Mode::Watch;
+        } else if(opt == "--jobs") {
+            ensure(arg + 1 < argc);
+            unwrap(jobs, from_chars<size_t>(argv[arg += 1]));
+            ensure(jobs > 0);
+            ret.jobs = jobs;
+        } else {
+            bail("unknown option");
+        }
+    }
+    if(ret.mode == Mode::Watch) {
+        ensure(argc - arg >= 1 && !ret.daemon);
+        ret.device = argv[arg];
+        ret.names.assign(argv + arg + 1, argv + argc);
+        return ret;
+    }
+    if(ret.mode != Mode::Set) {
+        ensure(argc - arg == 1 && !ret.daemon);
+        ret.device = argv[arg];
+        if(ret.mode == Mode::Restore) {
+            ret.devices = expand_devices(ret.device);
+            ensure(!ret.devices.empty());
+        }
+        return ret;
+    }
+    ensure(argc - arg >= 3 && (argc - arg) % 2 == 1 && !(ret.daemon && ret.request) && (ret.daemon || ret.socket == nullptr));
+    ret.device = argv[arg];
+    for(arg += 1; arg + 1 < argc; arg += 2) {
+        unwrap(assignment, parse_assignment(argv[arg], argv[arg + 1]));
+        ret.pairs.push_back(assignment);
+    }
+    if(!ret.daemon) {
+        ret.devices = expand_devices(ret.device);
+        ensure(!ret.devices.empty());
+    }
+    return ret;
+}
+
+auto run_snapshot(const Args& args) -> bool {
+    const auto fd = v4l2::open_device(args.device);
+    ensure(fd != -1);
+
+    const auto profile = v4l2::snapshot_profile(fd);
+    v4l2::close_device(fd);
+    ensure(profile);
+    ensure(v4l2::save_profile(*profile, args.profile));
+    printf("saved %zu controls\n", profile->values.size());
+    return true;
+}
 
-    const auto fd = open(argv[1], O_RDWR);
+auto run_restore(const v4l2::Profile& profile, const char* const device, FILE* const out, DeviceStats& stats) -> bool {
+    const auto fd = v4l2::open_device(device);
     ensure(fd != -1);
+    stats.timeline.mark("device opened");
 
-    for(auto& ctrl : v4l2::query_controls(fd)) {
-        for(auto key = 2; key + 1 < argc; key += 2) {
-            if(std::string_view(ctrl.name) != argv[key]) {
+    const auto result = v4l2::restore_profile(fd, profile, out);
+    stats.timeline.mark("profile restored");
+    v4l2::close_device(fd);
+    ensure(result);
+    fprintf(out, "wrote %zu controls, %zu already matched\n", result->written, result->skipped);
+    return true;
+}
+
+auto run_script_file(const int fd, const Args& args) -> bool {
+    const auto from_stdin = std::string_view(args.script) == "-";
+    const auto in_fd      = from_stdin ? STDIN_FILENO : open(args.script, O_RDONLY | O_CLOEXEC);
+    ensure(in_fd != -1, "failed to open script");
+
+    auto       runner = script::Runner(fd);
+    const auto ok     = runner.run(in_fd, STDOUT_FILENO);
+    if(!from_stdin) {
+        close(in_fd);
+    }
+    ensure(ok);
+    return runner.errors == 0;
+}
+
+auto run_script(const Args& args) -> bool {
+    const auto fd = v4l2::open_device(args.device);
+    ensure(fd != -1);
+    const auto ok = run_script_file(fd, args);
+    v4l2::close_device(fd);
+    return ok;
+}
+
+auto print_json_string(const std::string_view str) -> void {
+    putchar('"');
+    for(const auto c : str) {
+        if(c == '"' || c == '\\') {
+            putchar('\\');
+        }
+        putchar(c);
+    }
+    putchar('"');
+}
+
+// payload is the text form of the value of payload controls, which events do not carry
+auto print_event(const v4l2::ControlEvent& event, const std::string_view name, const std::string* const payload) -> void {
+    printf("{\"ts\":%llu.%06llu,\"id\":%u,\"name\":", (unsigned long long)(event.timestamp_ns / 1'000'000'000), (unsigned long long)(event.timestamp_ns % 1'000'000'000 / 1000), event.id);
+    print_json_string(name);
+    if(event.changes & V4L2_EVENT_CTRL_CH_VALUE) {
+        if(payload != nullptr) {
+            printf(",\"value\":");
+            print_json_string(*payload);
+        } else {
+            printf(",\"value\":%d", event.value);
+        }
+    }
+    if(event.changes & V4L2_EVENT_CTRL_CH_FLAGS) {
+        printf(",\"ro\":%s,\"inactive\":%s", event.ro ? "true" : "false", event.inactive ? "true" : "false");
+    }
+    if(event.changes & V4L2_EVENT_CTRL_CH_RANGE) {
+        printf(",\"min\":%d,\"max\":%d,\"step\":%d", event.min, event.max, event.step);
+    }
+    printf("}\n");
+}
+
+// blocks in poll() between events, no ioctls are issued while idle
+// terminated by SIGINT or SIGTERM
+auto watch_events(const int fd, const Args& args) -> bool {
+    auto table = v4l2::ControlTable();
+    table.assign(fd, v4l2::query_controls_cached(fd));
+    auto subscribed = size_t(0);
+    if(args.names.empty()) {
+        for(const auto id : table.ids) {
+            subscribed += v4l2::subscribe_control_events(fd, id);
+        }
+    } else {
+        for(const auto name : args.names) {
+            const auto index = table.find(std::string_view(name));
+            if(!index) {
+                fprintf(stderr, "\"%s\" not found\n", name);
                 continue;
             }
-            unwrap(value, from_chars<int>(argv[key + 1]), "invalid argument");
-            printf("\"%s\" = %s\n", argv[key], argv[key + 1]);
-            if(!v4l2::set_control(fd, ctrl.id, value)) {
-                line_warn("failed to set control value");
+            subscribed += v4l2::subscribe_control_events(fd, table.ids[*index]);
+        }
+    }
+    ensure(subscribed > 0, "no control events subscribed");
+
+    auto signals = sigset_t();
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    ensure(sigprocmask(SIG_BLOCK, &signals, nullptr) == 0);
+    const auto signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+    ensure(signal_fd != -1);
+
+    auto payload = std::string();
+    while(v4l2::wait_events(fd, signal_fd)) {
+        while(const auto event = v4l2::dequeue_event(fd)) {
+            // also reads payloads into the table
+            const auto index = table.apply_event(*event);
+            if(index && v4l2::has_payload(table.types[*index])) {
+                payload.clear();
+                v4l2::format_payload(table.get_payload(*index), payload);
+                print_event(*event, table.get_name(*index), &payload);
+            } else {
+                print_event(*event, index ? table.get_name(*index) : std::string_view(), nullptr);
+            }
+        }
+        // one flush per wakeup, not per event
+        fflush(stdout);
+    }
+    close(signal_fd);
+    return true;
+}
+
+auto run_watch(const Args& args) -> bool {
+    const auto fd = v4l2::open_device(args.device);
+    ensure(fd != -1);
+    const auto ok = watch_events(fd, args);
+    v4l2::close_device(fd);
+    return ok;
+}
+
+// the values take effect with the buffer of the request, failures are reported to out
+auto apply_request(v4l2::RequestPool& pool, const std::span<const v4l2::ControlValue> values, const std::span<const v4l2::Payload* const> payloads, FILE* const out) -> v4l2::BatchResult {
+    const auto failed  = v4l2::BatchResult{false, values.size() + payloads.size()};
+    const auto request = pool.acquire();
+    if(!request) {
+        fprintf(out, "failed to allocate request\n");
+        return failed;
+    }
+    auto result = pool.set_controls(*request, values, payloads);
+    if(result.ok && !pool.queue(*request)) {
+        fprintf(out, "failed to queue request%s\n", errno == ENOENT ? ", it has no buffer" : "");
+        result = failed;
+    } else if(result.ok && !pool.wait(*request, 1000)) {
+        fprintf(out, "request did not complete\n");
+        result = failed;
+    }
+    pool.release(*request);
+    return result;
+}
+
+// through the request pool if any, directly otherwise
+auto write_values(const int fd, v4l2::RequestPool* const pool, const std::span<const v4l2::ControlValue> values, const std::span<const v4l2::Payload* const> payloads, FILE* const out) -> v4l2::BatchResult {
+    return pool != nullptr ? apply_request(*pool, values, payloads, out) : v4l2::set_controls(fd, values, payloads);
+}
+
+// moves controls to their targets, one batched write per tick
+// stops at the first rejected tick, later ones would most likely fail the same way
+auto run_ramps(const int fd, v4l2::RequestPool* const pool, v4l2::ControlTable& table, v4l2::Ramps& ramps, const StatsFormat format, FILE* const out, DeviceStats& stats) -> bool {
+    auto values = std::vector<v4l2::ControlValue>();
+    auto writes = std::vector<v4l2::ControlValue>();
+    auto fds    = std::array{pollfd{.fd = ramps.get_timer_fd(), .events = POLLIN, .revents = 0}};
+    auto ok     = true;
+    while(ramps.is_running()) {
+        if(poll(fds.data(), fds.size(), -1) == -1) {
+            ensure(errno == EINTR);
+            continue;
+        }
+        values.clear();
+        ramps.tick(values);
+        // clamped and recorded through the table like the first batch
+        writes.clear();
+        for(const auto& value : values) {
+            if(const auto clamped = table.prepare_write(*table.find(value.id), value.value)) {
+                writes.push_back({value.id, *clamped});
             }
         }
+        if(!writes.empty() && !write_values(fd, pool, writes, {}, out).ok) {
+            ramps.cancel_all();
+            ok = false;
+        }
+    }
+    if(format != StatsFormat::None) {
+        fprintf(stats.file, "%s", format == StatsFormat::Json ? "," : "");
+        ramps.print_stats(stats.file, format == StatsFormat::Json);
+    }
+    return ok;
+}
+
+// pool is null unless the values go through media requests
+auto write_direct(const Args& args, const int fd, v4l2::RequestPool* const pool, FILE* const out, DeviceStats& stats) -> bool {
+    auto table = v4l2::ControlTable();
+    table.assign(fd, v4l2::query_controls_cached(fd));
+    stats.timeline.mark("controls enumerated");
+
+    auto values        = std::vector<v4l2::ControlValue>();
+    auto names         = std::vector<const char*>();
+    auto payloads      = std::vector<const v4l2::Payload*>();
+    auto payload_names = std::vector<const char*>();
+    auto ramps         = v4l2::Ramps();
+    for(const auto& [name, arg, target, duration] : args.pairs) {
+        const auto index = table.find(std::string_view(name));
+        if(!index) {
+            fprintf(out, "\"%s\" not found\n", name);
+            continue;
+        }
+        const auto type = table.types[*index];
+        if(v4l2::has_payload(type)) {
+            // parsed into the buffer of the table, written in the same batch as the others
+            ensure(!duration, "only integer controls can be ramped");
+            auto& payload = table.get_payload(*index);
+            ensure(v4l2::parse_payload(arg, payload), "invalid argument");
+            fprintf(out, "\"%s\" = %s\n", name, arg);
+            payloads.push_back(&payload);
+            payload_names.push_back(name);
+            continue;
+        }
+        unwrap(value, v4l2::parse_value(type, target), "invalid argument");
+        fprintf(out, "\"%s\" = %s\n", name, arg);
+        if(duration) {
+            ensure(type == v4l2::ControlType::Int, "only integer controls can be ramped");
+            const auto i = *index;
+            ramps.start(table.ids[i], table.currents[i], value, table.mins[i], table.steps[i], *duration);
+            continue;
+        }
+        const auto clamped = table.prepare_write(*index, value);
+        if(!clamped) {
+            continue;
+        }
+        if(*clamped != value) {
+            fprintf(out, "\"%s\" clamped to %d\n", name, *clamped);
+        }
+        values.push_back({table.ids[*index], *clamped});
+        names.push_back(name);
+    }
+
+    // error_index counts payloads after values
+    names.insert(names.end(), payload_names.begin(), payload_names.end());
+    const auto begin  = std::chrono::steady_clock::now();
+    const auto result = write_values(fd, pool, values, payloads, out);
+    stats.timeline.mark("values written");
+    if(pool != nullptr && result.ok) {
+        fprintf(out, "request completed in %.1fus\n", std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count());
+    }
+    if(!result.ok && result.error_index < names.size()) {
+        fprintf(out, "\"%s\" rejected\n", names[result.error_index]);
+    }
+    const auto ramped = !result.ok || !ramps.is_running() || run_ramps(fd, pool, table, ramps, args.stats, out, stats);
+    // printed with the other statistics at exit, ramp ticks included, also when the writes failed
+    if(args.stats != StatsFormat::None) {
+        fprintf(stats.file, "%s", args.stats == StatsFormat::Json ? "," : "");
+        table.print_write_stats(stats.file, args.stats == StatsFormat::Json);
+    }
+    ensure(result.ok, "failed to set control values");
+    ensure(ramped, "failed to set ramp values");
+    return true;
+}
+
+// the device is closed on every path of write_direct
+// with --request, one pool serves the device, so that ramp ticks reuse the request of the first batch
+auto run_direct(const Args& args, const char* const device, FILE* const out, DeviceStats& stats) -> bool {
+    const auto fd = v4l2::open_device(device);
+    ensure(fd != -1);
+    stats.timeline.mark("device opened");
+
+    if(!args.request) {
+        const auto ok = write_direct(args, fd, nullptr, out, stats);
+        v4l2::close_device(fd);
+        return ok;
+    }
+
+    const auto media_path = v4l2::find_media_device(device);
+    const auto media_fd   = v4l2::open_device(media_path ? media_path->data() : "");
+    if(media_fd == -1) {
+        fprintf(out, "no media device\n");
+        v4l2::close_device(fd);
+        return false;
+    }
+    auto ok = false;
+    {
+        // requests are closed before the media device
+        auto pool = v4l2::RequestPool(media_fd, fd);
+        ok        = write_direct(args, fd, &pool, out, stats);
+        if(args.stats != StatsFormat::None) {
+            fprintf(stats.file, "%s", args.stats == StatsFormat::Json ? "," : "");
+            pool.print_stats(stats.file, args.stats == StatsFormat::Json);
+        }
+    }
+    v4l2::close_device(media_fd);
+    v4l2::close_device(fd);
+    return ok;
+}
+
+auto run_client(const Args& args) -> bool {
+    unwrap(path, args.socket != nullptr ? std::optional<std::string>(args.socket) : protocol::get_socket_path());
+    unwrap(sock, protocol::connect_daemon(path.data()));
+
+    auto fields = std::vector<std::string_view>{"batch", args.device};
+    for(const auto& [name, arg, target, duration] : args.pairs) {
+        ensure(!duration, "ramps are not supported through the daemon");
+        printf("\"%s\" = %s\n", name, arg);
+        fields.emplace_back(name);
+        fields.emplace_back(arg);
+    }
+    unwrap(response, protocol::request(sock, protocol::join_fields(fields)));
+    close(sock);
+
+    const auto response_fields = protocol::split_fields(response);
+    if(response_fields[0] != "ok") {
+        const auto message = std::string(response_fields.size() >= 2 ? response_fields[1] : response);
+        printf("daemon: %s\n", message.data());
+        return false;
     }
     return true;
 }
+
+// runs fn on every device with at most jobs threads
+// output of each device is buffered and printed in device order
+// statistics of each device are stored in stats, in the format of args.stats
+template <class Fn>
+auto run_devices(const Args& args, std::vector<std::string>& stats, const Fn fn) -> bool {
+    const auto& devices = args.devices;
+    const auto  json    = args.stats == StatsFormat::Json;
+
+    // out is written to buf, stdout if null
+    const auto run_one = [&](const size_t i, std::string* const buf) -> bool {
+        auto       output_buf = (char*)nullptr;
+        auto       output_len = size_t(0);
+        auto       stats_buf  = (char*)nullptr;
+        auto       stats_len  = size_t(0);
+        const auto out        = buf != nullptr ? open_memstream(&output_buf, &output_len) : stdout;
+        auto       device     = DeviceStats{.timeline = {}, .file = open_memstream(&stats_buf, &stats_len)};
+        if(device.file == nullptr) {
+            device.file = stderr;
+        }
+        const auto ok = fn(devices[i].data(), out != nullptr ? out : stderr, device);
+        if(json) {
+            fputc(',', device.file);
+        }
+        device.timeline.print(device.file, json);
+        if(device.file != stderr) {
+            fclose(device.file);
+            stats[i].assign(stats_buf, stats_len);
+            free(stats_buf);
+        }
+        if(buf != nullptr && out != nullptr) {
+            fclose(out);
+            buf->assign(output_buf, output_len);
+            free(output_buf);
+        }
+        return ok;
+    };
+
+    stats.resize(devices.size());
+    if(devices.size() == 1) {
+        return run_one(0, nullptr);
+    }
+
+    struct Result {
+        std::string output;
+        bool        ok;
+    };
+    auto results = std::vector<Result>(devices.size());
+    auto next    = std::atomic_size_t(0);
+    {
+        auto workers = std::vector<std::jthread>();
+        for(auto i = 0u; i < std::min(args.jobs, devices.size()); i += 1) {
+            workers.emplace_back([&] {
+                for(auto i = next.fetch_add(1); i < devices.size(); i = next.fetch_add(1)) {
+                    results[i].ok = run_one(i, &results[i].output);
+                }
+            });
+        }
+    }
+
+    auto failed = size_t(0);
+    for(auto i = 0u; i < devices.size(); i += 1) {
+        printf("%s: %s\n%s", devices[i].data(), results[i].ok ? "ok" : "failed", results[i].output.data());
+        failed += !results[i].ok;
+    }
+    printf("%zu of %zu devices succeeded\n", devices.size() - failed, devices.size());
+    return failed == 0;
+}
+
+auto run_restore_all(const Args& args, std::vector<std::string>& stats) -> bool {
+    unwrap(profile, v4l2::load_profile(args.profile));
+    return run_devices(args, stats, [&profile](const char* const device, FILE* const out, DeviceStats& device_stats) {
+        return run_restore(profile, device, out, device_stats);
+    });
+}
+
+// process wide statistics followed by the ones of each device, a single object in json
+auto print_stats(const Args& args, const std::vector<std::string>& device_stats) -> void {
+    const auto json = args.stats == StatsFormat::Json;
+    if(!json) {
+        startup::print(stderr, false);
+        v4l2::print_ioctl_stats(stderr, false);
+        for(auto i = 0u; i < device_stats.size(); i += 1) {
+            fprintf(stderr, "%s:\n%s", args.devices[i].data(), device_stats[i].data());
+        }
+        return;
+    }
+    fprintf(stderr, "{");
+    startup::print(stderr, true);
+    fprintf(stderr, ",");
+    v4l2::print_ioctl_stats(stderr, true);
+    fprintf(stderr, ",\"devices\":[");
+    for(auto i = 0u; i < device_stats.size(); i += 1) {
+        fprintf(stderr, "%s{\"device\":\"%s\"%s}", i == 0 ? "" : ",", args.devices[i].data(), device_stats[i].data());
+    }
+    fprintf(stderr, "]}\n");
+}
+
+auto run(const int argc, const char* argv[]) -> bool {
+    startup::mark("main");
+    const auto args = parse_args(argc, argv);
+    if(!args) {
+        print_usage();
+        return false;
+    }
+    const auto direct = [&args](const char* const device, FILE* const out, DeviceStats& stats) { return run_direct(*args, device, out, stats); };
+
+    auto       device_stats = std::vector<std::string>();
+    const auto ok           = args->mode == Mode::Watch      ? run_watch(*args)
+                              : args->mode == Mode::Script   ? run_script(*args)
+                              : args->mode == Mode::Snapshot ? run_snapshot(*args)
+                              : args->mode == Mode::Restore  ? run_restore_all(*args, device_stats)
+                              : args->daemon                 ? run_client(*args)
+                                                             : run_devices(*args, device_stats, direct);
+    if(args->stats != StatsFormat::None) {
+        print_stats(*args, device_stats);
+    }
+    return ok;
+}
 } // namespace
 
 auto main(const int argc, const char* argv[]) -> int {
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include "cache.hpp"
+#include "macros/unwrap.hpp"
+#include "profile.hpp"
+#include "util/charconv.hpp"
+
+namespace v4l2 {
+namespace {
+auto copy_field(char* const dest, const size_t size, const std::string_view src) -> void {
+    const auto len = std::min(size - 1, src.size());
+    memcpy(dest, src.data(), len);
+    dest[len] = '\0';
+}
+
+// applies values, dropping controls the driver keeps rejecting (e.g. still inactive)
+auto apply_values(const int fd, std::vector<ControlValue>& values, std::vector<const char*>& names, FILE* const out) -> size_t {
+    while(!values.empty()) {
+        const auto result = set_controls(fd, values);
+        if(result.ok) {
+            break;
+        }
+        if(result.error_index >= values.size()) {
+            line_warn("failed to set control values");
+            return 0;
+        }
+        fprintf(out, "\"%s\" rejected\n", names[result.error_index]);
+        values.erase(values.begin() + result.error_index);
+        names.erase(names.begin() + result.error_index);
+    }
+    return values.size();
+}
+} // namespace
+
+auto snapshot_profile(const int fd) -> std::optional<Profile> {
+    unwrap(identity, query_identity(fd));
+    auto ret = Profile{.identity = identity, .values = {}};
+    for(const auto& ctrl : query_controls_cached(fd)) {
+        if(ctrl.ro || ctrl.wo || has_payload(ctrl.type)) {
+            continue;
+        }
+        ret.values.emplace_back(ctrl.name, ctrl.current);
+    }
+    return ret;
+}
+
+auto save_profile(const Profile& profile, const char* const path) -> bool {
+    auto file = std::ofstream(path);
+    ensure(file, "failed to open profile");
+    file << "@driver\t" << profile.identity.driver << '\n'
+         << "@card\t" << profile.identity.card << '\n'
+         << "@bus_info\t" << profile.identity.bus_info << '\n';
+    for(const auto& [name, value] : profile.values) {
+        file << name << '\t' << value << '\n';
+    }
+    file.flush();
+    ensure(file, "failed to write profile");
+    return true;
+}
+
+auto load_profile(const char* const path) -> std::optional<Profile> {
+    auto file = std::ifstream(path);
+    ensure(file, "failed to open profile");
+
+    auto ret  = Profile();
+    auto line = std::string();
+    while(std::getline(file, line)) {
+        if(line.empty()) {
+            continue;
+        }
+        const auto tab = line.rfind('\t');
+        ensure(tab != line.npos, "malformed profile");
+        const auto key   = std::string_view(line).substr(0, tab);
+        const auto value = std::string_view(line).substr(tab + 1);
+        if(key == "@driver") {
+            copy_field(ret.identity.driver, sizeof(ret.identity.driver), value);
+        } else if(key == "@card") {
+            copy_field(ret.identity.card, sizeof(ret.identity.card), value);
+        } else if(key == "@bus_info") {
+            copy_field(ret.identity.bus_info, sizeof(ret.identity.bus_info), value);
+        } else {
+            unwrap(num, from_chars<int32_t>(value), "malformed profile");
+            ret.values.emplace_back(key, num);
+        }
+    }
+    return ret;
+}
+
+auto restore_profile(const int fd, const Profile& profile, FILE* const out) -> std::optional<RestoreResult> {
+    unwrap(identity, query_identity(fd));
+    if(strcmp(identity.driver, profile.identity.driver) != 0 || strcmp(identity.card, profile.identity.card) != 0) {
+        line_warn("profile was taken from another device model");
+    }
+
+    // current values are read in bulk by the enumeration
+    const auto controls = query_controls_cached(fd);
+    auto       index    = std::unordered_map<std::string_view, const Control*>();
+    for(const auto& ctrl : controls) {
+        index.emplace(ctrl.name, &ctrl);
+    }
+
+    auto ret               = RestoreResult{0, 0};
+    auto controlling       = std::vector<ControlValue>();
+    auto controlling_names = std::vector<const char*>();
+    auto dependent         = std::vector<ControlValue>();
+    auto dependent_names   = std::vector<const char*>();
+    for(const auto& [name, value] : profile.values) {
+        const auto p = index.find(name);
+        if(p == index.end()) {
+            fprintf(out, "\"%s\" not found\n", name.data());
+            continue;
+        }
+        const auto& ctrl = *p->second;
+        if(ctrl.ro || has_payload(ctrl.type) || ctrl.current == value) {
+            ret.skipped += 1;
+            continue;
+        }
+        const auto is_controlling = ctrl.type != ControlType::Int;
+        (is_controlling ? controlling : dependent).push_back({ctrl.id, value});
+        (is_controlling ? controlling_names : dependent_names).push_back(ctrl.name);
+    }
+
+    ret.written += apply_values(fd, controlling, controlling_names, out);
+    ret.written += apply_values(fd, dependent, dependent_names, out);
+    return ret;
+}
+} // namespace v4l2
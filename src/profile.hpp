@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdio>
+#include <string>
+
+#include "v4l2.hpp"
+
+namespace v4l2 {
+// values of writable controls, stored as text:
+//   @driver   DRIVER
+//   @card     CARD
+//   @bus_info BUS_INFO
+//   NAME      VALUE
+// fields are separated by '\t'
+// Int64 and Payload controls are not stored
+struct Profile {
+    DeviceIdentity                               identity;
+    std::vector<std::pair<std::string, int32_t>> values;
+};
+
+auto snapshot_profile(int fd) -> std::optional<Profile>;
+auto save_profile(const Profile& profile, const char* path) -> bool;
+auto load_profile(const char* path) -> std::optional<Profile>;
+
+struct RestoreResult {
+    size_t written;
+    size_t skipped; // already equal to the profile
+};
+
+// writes only the controls that differ from profile
+// bool and menu controls are written first, as they may activate int controls
+// controls that are missing or rejected are reported to out
+auto restore_profile(int fd, const Profile& profile, FILE* out) -> std::optional<RestoreResult>;
+} // namespace v4l2
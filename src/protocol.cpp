@@ -0,0 +1,70 @@
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "macros/assert.hpp"
+#include "protocol.hpp"
+
+namespace protocol {
+auto get_socket_path() -> std::optional<std::string> {
+    const auto dir = getenv("XDG_RUNTIME_DIR");
+    ensure(dir != nullptr, "XDG_RUNTIME_DIR not set");
+    return std::string(dir) + "/v4l2-wlctl.sock";
+}
+
+auto split_fields(std::string_view line) -> std::vector<std::string_view> {
+    auto ret = std::vector<std::string_view>();
+    while(true) {
+        const auto pos = line.find(separator);
+        ret.emplace_back(line.substr(0, pos));
+        if(pos == line.npos) {
+            break;
+        }
+        line = line.substr(pos + 1);
+    }
+    return ret;
+}
+
+auto join_fields(const std::vector<std::string_view>& fields) -> std::string {
+    auto ret = std::string();
+    for(const auto field : fields) {
+        if(!ret.empty()) {
+            ret += separator;
+        }
+        ret += field;
+    }
+    ret += terminator;
+    return ret;
+}
+
+auto connect_daemon(const char* const path) -> std::optional<int> {
+    auto addr       = sockaddr_un();
+    addr.sun_family = AF_UNIX;
+    ensure(strlen(path) < sizeof(addr.sun_path), "socket path too long");
+    strcpy(addr.sun_path, path);
+
+    const auto sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    ensure(sock != -1);
+    if(connect(sock, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(sock);
+        bail("failed to connect to daemon");
+    }
+    return sock;
+}
+
+auto request(const int sock, const std::string_view message) -> std::optional<std::string> {
+    ensure(write(sock, message.data(), message.size()) == ssize_t(message.size()));
+
+    auto ret = std::string();
+    while(ret.empty() || ret.back() != terminator) {
+        char       buf[256];
+        const auto len = read(sock, buf, sizeof(buf));
+        ensure(len > 0, "connection closed");
+        ret.append(buf, len);
+    }
+    ret.pop_back();
+    return ret;
+}
+} // namespace protocol
@@ -0,0 +1,28 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// line protocol between v4l2-wlctl-daemon and its clients
+// fields are separated by '\t' and a message is terminated by '\n'
+// requests:
+//   get   DEVICE NAME                 -> ok VALUE
+//   set   DEVICE NAME VALUE           -> ok
+//   batch DEVICE NAME VALUE [NAME VALUE]... -> ok
+// any request can fail with:
+//   error MESSAGE
+namespace protocol {
+constexpr auto separator  = '\t';
+constexpr auto terminator = '\n';
+
+// $XDG_RUNTIME_DIR/v4l2-wlctl.sock
+auto get_socket_path() -> std::optional<std::string>;
+auto split_fields(std::string_view line) -> std::vector<std::string_view>;
+auto join_fields(const std::vector<std::string_view>& fields) -> std::string;
+
+// client side
+auto connect_daemon(const char* path) -> std::optional<int>;
+// returns the response line without the terminator
+auto request(int sock, std::string_view message) -> std::optional<std::string>;
+} // namespace protocol
@@ -0,0 +1,139 @@
+#include <cstring>
+#include <ctime>
+
+#include "publisher.hpp"
+#include "macros/assert.hpp"
+
+namespace v4l2 {
+namespace {
+// whether the object was left by a publisher that died, initialized or not
+auto is_stale_object(const std::string& name) -> bool {
+    // a live publisher writes its pid right after sizing the object
+    constexpr auto init_timeout_s = 1;
+
+    const auto fd = shm_open(name.data(), O_RDONLY | O_CLOEXEC, 0);
+    if(fd == -1) {
+        return errno == ENOENT;
+    }
+    struct stat st;
+    auto        header  = mirror::Header();
+    const auto  has_pid = pread(fd, &header, sizeof(header), 0) == sizeof(header) && header.pid != 0;
+    const auto  has_st  = fstat(fd, &st) == 0;
+    close(fd);
+    // the owner is checked before the magic, which is written last
+    if(has_pid) {
+        return !mirror::is_publisher_alive(&header);
+    }
+    return has_st && time(nullptr) - st.st_ctim.tv_sec > init_timeout_s;
+}
+
+// fails with EEXIST if a live process publishes the device, a mirror left by a dead one is replaced
+auto create_object(const std::string& name) -> int {
+    const auto fd = shm_open(name.data(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if(fd != -1 || errno != EEXIST) {
+        return fd;
+    }
+    if(!is_stale_object(name)) {
+        errno = EEXIST;
+        return -1;
+    }
+    shm_unlink(name.data());
+    return shm_open(name.data(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+}
+} // namespace
+
+static_assert(uint32_t(ControlTable::ReadOnly) == mirror::ReadOnly &&
+              uint32_t(ControlTable::WriteOnly) == mirror::WriteOnly &&
+              uint32_t(ControlTable::Inactive) == mirror::Inactive &&
+              uint32_t(ControlTable::Volatile) == mirror::Volatile &&
+              uint32_t(ControlTable::Execute) == mirror::Execute);
+
+auto Publisher::begin_write() -> void {
+    auto sequence = std::atomic_ref(header->sequence);
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+auto Publisher::end_write() -> void {
+    auto sequence = std::atomic_ref(header->sequence);
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+auto Publisher::write_entry(const ControlTable& table, const size_t index) -> void {
+    auto& entry = ((mirror::Entry*)(header + 1))[index];
+    std::atomic_ref(entry.flags).store(table.flags[index] | (has_payload(table.types[index]) ? mirror::NoValue : 0u), std::memory_order_relaxed);
+    std::atomic_ref(entry.value).store(table.currents[index], std::memory_order_relaxed);
+    std::atomic_ref(entry.min).store(table.mins[index], std::memory_order_relaxed);
+    std::atomic_ref(entry.max).store(table.maxs[index], std::memory_order_relaxed);
+    std::atomic_ref(entry.step).store(table.steps[index], std::memory_order_relaxed);
+}
+
+auto Publisher::is_valid() const -> bool {
+    return header != nullptr;
+}
+
+auto Publisher::publish(const ControlTable& table, const size_t index) -> void {
+    if(header == nullptr || index >= header->count) {
+        return;
+    }
+    begin_write();
+    write_entry(table, index);
+    end_write();
+}
+
+auto Publisher::publish(const ControlTable& table) -> void {
+    if(header == nullptr) {
+        return;
+    }
+    begin_write();
+    for(auto i = 0u; i < header->count; i += 1) {
+        write_entry(table, i);
+    }
+    end_write();
+}
+
+Publisher::Publisher(const std::string_view device, const ControlTable& table)
+    : name(mirror::get_shm_name(device)) {
+    const auto fd = create_object(name);
+    if(fd == -1) {
+        if(errno == EEXIST) {
+            line_warn("control mirror is published by another process");
+        } else {
+            line_warn("failed to create control mirror");
+        }
+        return;
+    }
+    const auto count = table.size();
+    size             = sizeof(mirror::Header) + sizeof(mirror::Entry) * count;
+    const auto ptr   = ftruncate(fd, size) == 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(ptr == MAP_FAILED) {
+        line_warn("failed to map control mirror");
+        shm_unlink(name.data());
+        return;
+    }
+
+    // ids and names are fixed, readers do not see them change
+    header          = (mirror::Header*)ptr;
+    header->version = mirror::version;
+    header->count   = count;
+    header->pid     = getpid();
+
+    const auto entries = (mirror::Entry*)(header + 1);
+    for(auto i = 0u; i < count; i += 1) {
+        const auto label = table.get_name(i);
+        entries[i].id    = table.ids[i];
+        memcpy(entries[i].name, label.data(), std::min(label.size(), sizeof(entries[i].name) - 1));
+    }
+    publish(table);
+    // readers check the magic last
+    std::atomic_ref(header->magic).store(mirror::magic, std::memory_order_release);
+}
+
+Publisher::~Publisher() {
+    if(header != nullptr) {
+        munmap(header, size);
+        shm_unlink(name.data());
+    }
+}
+} // namespace v4l2
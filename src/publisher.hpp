@@ -0,0 +1,28 @@
+#pragma once
+#include "control-table.hpp"
+#include "mirror.hpp"
+
+namespace v4l2 {
+// keeps the shared memory mirror of a control table, see mirror.hpp
+// only an object created by this process is written, and it is unlinked on destruction
+class Publisher {
+  private:
+    std::string     name;
+    mirror::Header* header = nullptr;
+    size_t          size   = 0;
+
+    auto begin_write() -> void;
+    auto end_write() -> void;
+    auto write_entry(const ControlTable& table, size_t index) -> void;
+
+  public:
+    auto is_valid() const -> bool;
+    // call after table values or flags of index changed
+    auto publish(const ControlTable& table, size_t index) -> void;
+    auto publish(const ControlTable& table) -> void;
+
+    // the table must not be reassigned while published
+    Publisher(std::string_view device, const ControlTable& table);
+    ~Publisher();
+};
+} // namespace v4l2
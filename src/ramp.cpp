@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ramp.hpp"
+
+namespace v4l2 {
+namespace {
+auto now_ns() -> uint64_t {
+    auto ts = timespec();
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+auto to_timespec(const uint64_t ns) -> timespec {
+    return {.tv_sec = time_t(ns / 1000000000), .tv_nsec = long(ns % 1000000000)};
+}
+
+auto quantize(const double value, const int32_t min, const int32_t step) -> int32_t {
+    return min + int32_t(std::lround((value - min) / step)) * step;
+}
+
+auto interpolate(const double t, const Ramps::Curve curve) -> double {
+    switch(curve) {
+    case Ramps::Curve::Linear:
+        return t;
+    case Ramps::Curve::Smooth:
+        return t * t * (3 - 2 * t);
+    }
+    return t;
+}
+} // namespace
+
+auto Ramps::arm(const uint64_t first_ns, const uint64_t interval_ns) -> void {
+    const auto spec = itimerspec{.it_interval = to_timespec(interval_ns), .it_value = to_timespec(first_ns)};
+    timerfd_settime(timer_fd, 0, &spec, nullptr);
+}
+
+auto Ramps::start(const uint32_t id, const int32_t from, const int32_t to, const int32_t min, const int32_t step, const uint64_t duration_ns, const Curve curve) -> void {
+    const auto now     = now_ns();
+    const auto quantum = std::max(step, 1);
+
+    const auto ramp = Ramp{
+        .id          = id,
+        .from        = from,
+        .to          = quantize(to, min, quantum),
+        .min         = min,
+        .step        = quantum,
+        .last        = from,
+        .begin_ns    = now,
+        .duration_ns = duration_ns,
+        .curve       = curve,
+    };
+    if(const auto p = std::ranges::find(ramps, id, &Ramp::id); p != ramps.end()) {
+        *p = ramp;
+    } else {
+        ramps.push_back(ramp);
+    }
+    if(armed_ns == 0) {
+        armed_ns    = now;
+        expirations = 0;
+        arm(period_ns, period_ns);
+    }
+}
+
+auto Ramps::cancel(const uint32_t id) -> void {
+    std::erase_if(ramps, [id](const Ramp& ramp) { return ramp.id == id; });
+    if(ramps.empty() && armed_ns != 0) {
+        // a zero itimerspec disarms the timer
+        armed_ns = 0;
+        arm(0, 0);
+    }
+}
+
+auto Ramps::cancel_all() -> void {
+    ramps.clear();
+    armed_ns = 0;
+    arm(0, 0);
+}
+
+auto Ramps::is_running() const -> bool {
+    return !ramps.empty();
+}
+
+auto Ramps::get_timer_fd() const -> int {
+    return timer_fd;
+}
+
+auto Ramps::tick(std::vector<ControlValue>& values) -> void {
+    auto count = uint64_t(0);
+    if(read(timer_fd, &count, sizeof(count)) != sizeof(count) || count == 0 || armed_ns == 0) {
+        return;
+    }
+    const auto now = now_ns();
+    expirations += count;
+    stats.ticks += 1;
+    stats.missed += count - 1;
+    const auto deadline = armed_ns + expirations * period_ns;
+    const auto jitter   = now > deadline ? now - deadline : 0;
+    stats.total_jitter_ns += jitter;
+    stats.max_jitter_ns = std::max(stats.max_jitter_ns, jitter);
+
+    for(auto& ramp : ramps) {
+        const auto elapsed = now - ramp.begin_ns;
+        const auto t       = ramp.duration_ns == 0 ? 1.0 : std::min(1.0, double(elapsed) / ramp.duration_ns);
+        const auto value   = t >= 1.0 ? ramp.to : quantize(ramp.from + (ramp.to - ramp.from) * interpolate(t, ramp.curve), ramp.min, ramp.step);
+        if(value != ramp.last) {
+            ramp.last = value;
+            values.push_back({ramp.id, value});
+        }
+        if(t >= 1.0) {
+            ramp.id = 0;
+        }
+    }
+    std::erase_if(ramps, [](const Ramp& ramp) { return ramp.id == 0; });
+
+    if(ramps.empty()) {
+        armed_ns = 0;
+        arm(0, 0);
+    }
+}
+
+auto Ramps::interrupt() -> void {
+    armed_ns = 0;
+    arm(1, 0);
+}
+
+auto Ramps::get_stats() const -> const Stats& {
+    return stats;
+}
+
+auto Ramps::print_stats(FILE* const out, const bool json) const -> void {
+    const auto average_us = stats.ticks == 0 ? 0.0 : stats.total_jitter_ns / 1e3 / stats.ticks;
+    if(json) {
+        fprintf(out, "\"ramps\":{\"ticks\":%" PRIu64 ",\"missed\":%" PRIu64 ",\"jitter_avg_us\":%.1f,\"jitter_max_us\":%.1f}",
+                stats.ticks, stats.missed, average_us, stats.max_jitter_ns / 1e3);
+    } else {
+        fprintf(out, "ramps: %" PRIu64 " ticks, %" PRIu64 " missed, jitter avg %.1fus max %.1fus\n",
+                stats.ticks, stats.missed, average_us, stats.max_jitter_ns / 1e3);
+    }
+}
+
+Ramps::Ramps(const uint64_t period_ns)
+    : timer_fd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      period_ns(period_ns) {
+}
+
+Ramps::~Ramps() {
+    close(timer_fd);
+}
+} // namespace v4l2
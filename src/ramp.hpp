@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdio>
+
+#include "v4l2.hpp"
+
+namespace v4l2 {
+// moves controls towards targets over time instead of in one step
+// every running ramp advances on the same timerfd tick, so one tick yields one batch of values
+class Ramps {
+  public:
+    enum class Curve {
+        Linear,
+        Smooth, // ease in and out
+    };
+
+    struct Stats {
+        uint64_t ticks           = 0;
+        uint64_t missed          = 0; // expirations that were not served in time
+        uint64_t total_jitter_ns = 0;
+        uint64_t max_jitter_ns   = 0;
+    };
+
+  private:
+    struct Ramp {
+        uint32_t id;
+        int32_t  from;
+        int32_t  to;
+        int32_t  min;
+        int32_t  step;
+        int32_t  last;
+        uint64_t begin_ns;
+        uint64_t duration_ns;
+        Curve    curve;
+    };
+
+    int               timer_fd;
+    uint64_t          period_ns;
+    uint64_t          armed_ns    = 0;
+    uint64_t          expirations = 0;
+    std::vector<Ramp> ramps;
+    Stats             stats;
+
+    auto arm(uint64_t first_ns, uint64_t interval_ns) -> void;
+
+  public:
+    // replaces the running ramp of the same control
+    // values are quantized to min + n * step
+    auto start(uint32_t id, int32_t from, int32_t to, int32_t min, int32_t step, uint64_t duration_ns, Curve curve = Curve::Linear) -> void;
+    auto cancel(uint32_t id) -> void;
+    auto cancel_all() -> void;
+    auto is_running() const -> bool;
+    // readable on each tick
+    auto get_timer_fd() const -> int;
+    // call when the timer fd is readable
+    // appends the values that changed since the previous tick
+    auto tick(std::vector<ControlValue>& values) -> void;
+    // makes the timer fd readable once, to wake up a waiting task
+    auto interrupt() -> void;
+    auto get_stats() const -> const Stats&;
+    // a line, or a json member "ramps":{...}
+    auto print_stats(FILE* out, bool json) const -> void;
+
+    Ramps(uint64_t period_ns = 10'000'000);
+    ~Ramps();
+};
+} // namespace v4l2
@@ -0,0 +1,104 @@
+#include <cinttypes>
+#include <filesystem>
+
+#include <poll.h>
+
+#include "request.hpp"
+
+namespace v4l2 {
+auto RequestPool::acquire() -> std::optional<int> {
+    if(!idle.empty()) {
+        const auto request = idle.back();
+        idle.pop_back();
+        stats.reused += 1;
+        return request;
+    }
+    const auto request = alloc_request(media_fd);
+    if(!request) {
+        return std::nullopt;
+    }
+    requests.push_back(*request);
+    stats.allocated += 1;
+    return request;
+}
+
+auto RequestPool::set_controls(const int request, const std::span<const ControlValue> values, const std::span<const Payload* const> payloads) -> BatchResult {
+    return set_request_controls(video_fd, request, values, payloads);
+}
+
+auto RequestPool::queue(const int request) -> bool {
+    if(!queue_request(request)) {
+        stats.failed += 1;
+        return false;
+    }
+    return true;
+}
+
+auto RequestPool::wait(const int request, const int timeout_ms) -> bool {
+    // completion is reported as POLLPRI, errors are reported whether requested or not
+    auto pfd = pollfd{.fd = request, .events = POLLPRI, .revents = 0};
+    while(true) {
+        const auto ret = poll(&pfd, 1, timeout_ms);
+        if(ret == -1 && errno == EINTR) {
+            continue;
+        }
+        if(ret != 1 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) || !(pfd.revents & POLLPRI)) {
+            stats.failed += 1;
+            return false;
+        }
+        stats.completed += 1;
+        return true;
+    }
+}
+
+auto RequestPool::release(const int request) -> void {
+    if(!reinit_request(request)) {
+        // still in use by the driver, drop it
+        std::erase(requests, request);
+        close_device(request);
+        return;
+    }
+    idle.push_back(request);
+}
+
+auto RequestPool::get_stats() const -> const Stats& {
+    return stats;
+}
+
+auto RequestPool::print_stats(FILE* const out, const bool json) const -> void {
+    if(json) {
+        fprintf(out, "\"requests\":{\"allocated\":%" PRIu64 ",\"reused\":%" PRIu64 ",\"completed\":%" PRIu64 ",\"failed\":%" PRIu64 "}",
+                stats.allocated, stats.reused, stats.completed, stats.failed);
+    } else {
+        fprintf(out, "requests: %" PRIu64 " allocated, %" PRIu64 " reused, %" PRIu64 " completed, %" PRIu64 " failed\n",
+                stats.allocated, stats.reused, stats.completed, stats.failed);
+    }
+}
+
+RequestPool::RequestPool(const int media_fd, const int video_fd)
+    : media_fd(media_fd),
+      video_fd(video_fd) {
+}
+
+RequestPool::~RequestPool() {
+    for(const auto request : requests) {
+        close_device(request);
+    }
+}
+
+auto find_media_device(const char* const video_path) -> std::optional<std::string> {
+    auto       error = std::error_code();
+    const auto path  = std::filesystem::canonical(video_path, error);
+    if(error) {
+        return std::nullopt;
+    }
+    const auto device_dir = std::filesystem::path("/sys/class/video4linux") / path.filename() / "device";
+    for(const auto& entry : std::filesystem::directory_iterator(device_dir, error)) {
+        const auto name = entry.path().filename().string();
+        if(name.starts_with("media")) {
+            return "/dev/" + name;
+        }
+    }
+    return std::nullopt;
+}
+} // namespace v4l2
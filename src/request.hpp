@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdio>
+#include <string>
+
+#include "v4l2.hpp"
+
+namespace v4l2 {
+// control batches bound to a media request, so that they take effect on the frame
+// of the buffer queued to the same request instead of on an arbitrary one
+// requests are allocated on demand and reinitialized for reuse, never freed until destruction
+class RequestPool {
+  public:
+    struct Stats {
+        uint64_t allocated = 0;
+        uint64_t reused    = 0;
+        uint64_t completed = 0;
+        uint64_t failed    = 0; // failed to queue or timed out
+    };
+
+  private:
+    int              media_fd;
+    int              video_fd;
+    std::vector<int> requests;
+    std::vector<int> idle;
+    Stats            stats;
+
+  public:
+    // returns a request fd owned by the pool
+    auto acquire() -> std::optional<int>;
+    auto set_controls(int request, std::span<const ControlValue> values, std::span<const Payload* const> payloads = {}) -> BatchResult;
+    // a driver may refuse requests without a buffer, queue it with V4L2_BUF_FLAG_REQUEST_FD first
+    auto queue(int request) -> bool;
+    // returns false on timeout or error
+    auto wait(int request, int timeout_ms) -> bool;
+    // reinitializes the request and returns it to the pool
+    auto release(int request) -> void;
+    auto get_stats() const -> const Stats&;
+    // a line, or a json member "requests":{...}
+    auto print_stats(FILE* out, bool json) const -> void;
+
+    RequestPool(int media_fd, int video_fd);
+    ~RequestPool();
+};
+
+// /dev/mediaN of the device /dev/videoN belongs to, found through sysfs
+auto find_media_device(const char* video_path) -> std::optional<std::string>;
+} // namespace v4l2
@@ -0,0 +1,232 @@
+#include <array>
+
+#include <unistd.h>
+
+#include "cache.hpp"
+#include "macros/assert.hpp"
+#include "protocol.hpp"
+#include "script.hpp"
+#include "value-text.hpp"
+
+namespace script {
+namespace {
+// same as protocol::split_fields, but reuses ret
+auto split_fields(std::string_view line, std::vector<std::string_view>& ret) -> void {
+    ret.clear();
+    if(line.ends_with('\r')) {
+        line.remove_suffix(1);
+    }
+    if(line.empty()) {
+        return;
+    }
+    while(true) {
+        const auto pos = line.find(protocol::separator);
+        ret.emplace_back(line.substr(0, pos));
+        if(pos == line.npos) {
+            break;
+        }
+        line = line.substr(pos + 1);
+    }
+}
+
+auto write_all(const int fd, std::string_view data) -> bool {
+    while(!data.empty()) {
+        const auto len = write(fd, data.data(), data.size());
+        if(len < 0 && errno == EINTR) {
+            continue;
+        }
+        ensure(len > 0);
+        data = data.substr(len);
+    }
+    return true;
+}
+} // namespace
+
+auto Runner::append_error(const std::string_view message) -> void {
+    errors += 1;
+    output += "error";
+    output += protocol::separator;
+    output += message;
+    output += protocol::terminator;
+}
+
+auto Runner::append_value(const v4l2::ControlType type, const int32_t value) -> void {
+    output += protocol::separator;
+    v4l2::format_value(type, value, output);
+}
+
+auto Runner::append_payload(const size_t index) -> void {
+    output += protocol::separator;
+    v4l2::format_payload(table.get_payload(index), output);
+}
+
+auto Runner::resync_values() -> void {
+    v4l2::read_values(fd, values);
+    for(const auto& value : values) {
+        if(value.id != 0) {
+            table.currents[*table.find(value.id)] = value.value;
+        }
+    }
+}
+
+auto Runner::execute(const std::string_view line) -> void {
+    split_fields(line, fields);
+    if(fields.empty() || fields[0].starts_with('#')) {
+        return;
+    }
+    commands += 1;
+
+    const auto command = fields[0];
+    if(command == "dump") {
+        if(fields.size() != 1) {
+            append_error("malformed command");
+            return;
+        }
+        // every control is listed, ones that cannot be read have an empty value
+        table.read_values(failed);
+        output += "ok";
+        for(auto i = 0u, f = 0u; i < table.size(); i += 1) {
+            output += protocol::separator;
+            output += table.get_name(i);
+            const auto is_failed = f < failed.size() && failed[f] == i;
+            f += is_failed;
+            if(is_failed || table.flags[i] & v4l2::ControlTable::WriteOnly) {
+                output += protocol::separator;
+            } else if(!v4l2::has_payload(table.types[i])) {
+                append_value(table.types[i], table.currents[i]);
+            } else if(table.read_payload(i)) {
+                append_payload(i);
+            } else {
+                output += protocol::separator;
+            }
+        }
+        output += protocol::terminator;
+        return;
+    }
+    if(command == "get") {
+        if(fields.size() != 2) {
+            append_error("malformed command");
+            return;
+        }
+        const auto index = table.find(fields[1]);
+        if(!index) {
+            append_error("no such control");
+            return;
+        }
+        if(v4l2::has_payload(table.types[*index])) {
+            if(!table.read_payload(*index)) {
+                append_error("failed to get control value");
+                return;
+            }
+            output += "ok";
+            append_payload(*index);
+            output += protocol::terminator;
+            return;
+        }
+        const auto value = v4l2::get_control(fd, table.ids[*index]);
+        if(!value) {
+            append_error("failed to get control value");
+            return;
+        }
+        table.currents[*index] = *value;
+        output += "ok";
+        append_value(table.types[*index], *value);
+        output += protocol::terminator;
+        return;
+    }
+    if(!(command == "set" && fields.size() == 3) && !(command == "batch" && fields.size() >= 3 && fields.size() % 2 == 1)) {
+        append_error(command == "set" || command == "batch" ? "malformed command" : "unknown command");
+        return;
+    }
+
+    values.clear();
+    sources.clear();
+    for(auto i = 1u; i + 1 < fields.size(); i += 2) {
+        const auto index = table.find(fields[i]);
+        if(!index) {
+            append_error("no such control");
+            return;
+        }
+        if(v4l2::has_payload(table.types[*index])) {
+            if(command == "batch") {
+                append_error("payload controls cannot be batched");
+                return;
+            }
+            // parsed into the buffer of the table, nothing is allocated
+            auto& payload = table.get_payload(*index);
+            if(!v4l2::parse_payload(fields[i + 1], payload)) {
+                append_error("invalid value");
+                return;
+            }
+            if(!v4l2::set_payload(fd, payload)) {
+                // the buffer of the table holds the rejected value
+                table.read_payload(*index);
+                append_error("failed to set control value");
+                return;
+            }
+            output += "ok";
+            output += protocol::terminator;
+            return;
+        }
+        const auto value = v4l2::parse_value(table.types[*index], fields[i + 1]);
+        if(!value) {
+            append_error("invalid value");
+            return;
+        }
+        // write-through like the window and the daemon, values that are already current are not sent
+        if(const auto clamped = table.prepare_write(*index, *value)) {
+            values.push_back({table.ids[*index], *clamped});
+            sources.push_back(i);
+        }
+    }
+    if(values.size() == 1) {
+        if(!v4l2::set_control(fd, values[0].id, values[0].value)) {
+            resync_values();
+            append_error("failed to set control value");
+            return;
+        }
+    } else if(const auto result = v4l2::set_controls(fd, values); !result.ok) {
+        resync_values();
+        append_error(result.error_index < values.size() ? fields[sources[result.error_index]] : "failed to set control values");
+        return;
+    }
+    output += "ok";
+    output += protocol::terminator;
+}
+
+auto Runner::run(const int in_fd, const int out_fd) -> bool {
+    auto buffer = std::string();
+    auto chunk  = std::array<char, 65536>();
+    while(true) {
+        const auto len = read(in_fd, chunk.data(), chunk.size());
+        if(len < 0 && errno == EINTR) {
+            continue;
+        }
+        ensure(len >= 0);
+        if(len == 0) {
+            break;
+        }
+        buffer.append(chunk.data(), len);
+
+        auto begin = size_t(0);
+        for(auto end = buffer.find('\n'); end != buffer.npos; end = buffer.find('\n', begin)) {
+            execute(std::string_view(buffer).substr(begin, end - begin));
+            begin = end + 1;
+        }
+        buffer.erase(0, begin);
+
+        // flush before blocking on the next read so that interactive callers see responses
+        ensure(write_all(out_fd, output));
+        output.clear();
+    }
+    // last line without terminator
+    execute(buffer);
+    return write_all(out_fd, output);
+}
+
+Runner::Runner(const int fd)
+    : fd(fd) {
+    // the enumerated vector is dropped here, the table is the only copy
+    table.assign(fd, v4l2::query_controls_cached(fd));
+}
+} // namespace script
@@ -0,0 +1,42 @@
+#pragma once
+#include "control-table.hpp"
+
+// commands read line by line, fields separated by '\t' as control names contain spaces
+//   get   NAME                   -> ok VALUE
+//   set   NAME VALUE             -> ok
+//   batch NAME VALUE [NAME VALUE]... -> ok
+//   dump                         -> ok NAME VALUE [NAME VALUE]...
+// values are in the text form of value-text.hpp, payload controls cannot be batched
+// any command can fail with:
+//   error MESSAGE
+// responses use the daemon protocol format, one line per command
+// empty lines and lines starting with '#' are ignored
+namespace script {
+class Runner {
+  private:
+    int                             fd;
+    v4l2::ControlTable              table;
+    std::vector<std::string_view>   fields;
+    std::vector<v4l2::ControlValue> values;
+    std::vector<size_t>             sources; // index of the name field of each value
+    std::vector<size_t>             failed;  // indices into table
+    std::string                     output;
+
+    auto append_error(std::string_view message) -> void;
+    auto append_value(v4l2::ControlType type, int32_t value) -> void;
+    auto append_payload(size_t index) -> void;
+    // the table records written values as current, reads back the ones of a failed write
+    auto resync_values() -> void;
+    auto execute(std::string_view line) -> void;
+
+  public:
+    size_t commands = 0;
+    size_t errors   = 0;
+
+    // returns false on i/o error
+    // output is written once per input chunk, not per command
+    auto run(int in_fd, int out_fd) -> bool;
+
+    Runner(int fd);
+};
+} // namespace script
@@ -0,0 +1,58 @@
+#include <mutex>
+
+#include "startup.hpp"
+
+namespace startup {
+namespace {
+using Clock = std::chrono::steady_clock;
+
+auto lock    = std::mutex();
+auto global  = Timeline();
+auto origin  = Clock::time_point();
+auto started = false;
+} // namespace
+
+auto Timeline::mark(const char* const phase) -> void {
+    phases.push_back({phase, Clock::now()});
+}
+
+auto Timeline::print(FILE* const out, const bool json) const -> void {
+    if(phases.empty()) {
+        // the member is always printed, so that callers can place separators unconditionally
+        if(json) {
+            fprintf(out, "\"startup\":[]");
+        }
+        return;
+    }
+    // timelines of workers share the origin of the process wide one
+    const auto begin = started ? origin : phases.front().time;
+    const auto ms    = [begin](const Phase& phase) { return std::chrono::duration<double, std::milli>(phase.time - begin).count(); };
+    if(json) {
+        fprintf(out, "\"startup\":[");
+        for(auto i = 0u; i < phases.size(); i += 1) {
+            fprintf(out, "%s{\"phase\":\"%s\",\"ms\":%.3f}", i == 0 ? "" : ",", phases[i].name, ms(phases[i]));
+        }
+        fprintf(out, "]");
+    } else {
+        fprintf(out, "startup:\n");
+        for(const auto& phase : phases) {
+            fprintf(out, "  %9.3fms  %s\n", ms(phase), phase.name);
+        }
+    }
+}
+
+auto mark(const char* const phase) -> void {
+    auto guard = std::lock_guard(lock);
+    if(!started) {
+        // set once before any worker starts
+        origin  = Clock::now();
+        started = true;
+    }
+    global.mark(phase);
+}
+
+auto print(FILE* const out, const bool json) -> void {
+    auto guard = std::lock_guard(lock);
+    global.print(out, json);
+}
+} // namespace startup
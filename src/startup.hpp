@@ -0,0 +1,29 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// time to each startup phase, measured from the first process wide mark
+namespace startup {
+// phases of one unit of work, e.g. a device processed by a worker thread
+// not thread safe, each worker keeps its own
+class Timeline {
+  private:
+    struct Phase {
+        const char*                           name;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    std::vector<Phase> phases;
+
+  public:
+    auto mark(const char* phase) -> void;
+    // a human readable list, or a json member "startup":[...] to be wrapped in an object by the caller
+    // the json member is printed even if nothing was marked
+    auto print(FILE* out, bool json) const -> void;
+};
+
+// process wide timeline, thread safe
+auto mark(const char* phase) -> void;
+auto print(FILE* out, bool json) -> void;
+} // namespace startup
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cinttypes>
+
+#include <linux/media.h>
+#include <linux/videodev2.h>
+
+#include "stats.hpp"
+
+namespace v4l2 {
+namespace {
+struct Counters {
+    std::atomic_uint64_t                              calls;
+    std::atomic_uint64_t                              retries;
+    std::atomic_uint64_t                              errors;
+    std::atomic_uint64_t                              total_ns;
+    std::atomic_uint64_t                              max_ns;
+    std::array<std::atomic_uint64_t, latency_buckets> histogram;
+};
+
+struct Request {
+    unsigned long request;
+    const char*   name;
+};
+
+#define REQUEST(def) Request{def, #def}
+constexpr auto requests = std::array{
+    REQUEST(VIDIOC_QUERYCAP),
+    REQUEST(VIDIOC_QUERYCTRL),
+    REQUEST(VIDIOC_QUERY_EXT_CTRL),
+    REQUEST(VIDIOC_QUERYMENU),
+    REQUEST(VIDIOC_G_CTRL),
+    REQUEST(VIDIOC_S_CTRL),
+    REQUEST(VIDIOC_G_EXT_CTRLS),
+    REQUEST(VIDIOC_S_EXT_CTRLS),
+    REQUEST(VIDIOC_TRY_EXT_CTRLS),
+    REQUEST(VIDIOC_SUBSCRIBE_EVENT),
+    REQUEST(VIDIOC_DQEVENT),
+    REQUEST(MEDIA_IOC_REQUEST_ALLOC),
+    REQUEST(MEDIA_REQUEST_IOC_QUEUE),
+    REQUEST(MEDIA_REQUEST_IOC_REINIT),
+    Request{0, "other"},
+};
+#undef REQUEST
+
+std::array<Counters, requests.size()> counters;
+
+auto bucket_of(const uint64_t ns) -> size_t {
+    const auto us = ns / 1000;
+    return us == 0 ? 0 : std::min<size_t>(std::bit_width(us), latency_buckets - 1);
+}
+
+// upper bound of the bucket where p of calls fall in
+auto percentile_us(const IoctlStats& stats, const double p) -> uint64_t {
+    const auto max = stats.max_ns / 1000;
+    auto       sum = uint64_t(0);
+    for(auto i = 0; i < latency_buckets; i += 1) {
+        sum += stats.histogram[i];
+        if(sum >= stats.calls * p) {
+            return std::min(uint64_t(1) << i, max);
+        }
+    }
+    return max;
+}
+} // namespace
+
+auto record_ioctl(const unsigned long request, const uint64_t ns, const uint32_t retries, const bool error) -> void {
+    auto index = requests.size() - 1;
+    for(auto i = 0u; i + 1 < requests.size(); i += 1) {
+        if(requests[i].request == request) {
+            index = i;
+            break;
+        }
+    }
+
+    auto& c = counters[index];
+    c.calls.fetch_add(1, std::memory_order_relaxed);
+    c.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    c.histogram[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    if(retries != 0) {
+        c.retries.fetch_add(retries, std::memory_order_relaxed);
+    }
+    if(error) {
+        c.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    for(auto max = c.max_ns.load(std::memory_order_relaxed); ns > max && !c.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed);) {
+    }
+}
+
+auto get_ioctl_stats() -> std::vector<IoctlStats> {
+    auto ret = std::vector<IoctlStats>();
+    for(auto i = 0u; i < requests.size(); i += 1) {
+        const auto& c = counters[i];
+        if(c.calls == 0) {
+            continue;
+        }
+        auto& stats = ret.emplace_back(IoctlStats{
+            .name      = requests[i].name,
+            .calls     = c.calls,
+            .retries   = c.retries,
+            .errors    = c.errors,
+            .total_ns  = c.total_ns,
+            .max_ns    = c.max_ns,
+            .histogram = {},
+        });
+        for(auto b = 0; b < latency_buckets; b += 1) {
+            stats.histogram[b] = c.histogram[b];
+        }
+    }
+    return ret;
+}
+
+auto print_ioctl_stats(FILE* const out, const bool json) -> void {
+    const auto stats = get_ioctl_stats();
+    if(json) {
+        fprintf(out, "\"ioctls\":[");
+        for(auto i = 0u; i < stats.size(); i += 1) {
+            const auto& s = stats[i];
+            fprintf(out, "%s{\"request\":\"%s\",\"calls\":%" PRIu64 ",\"retries\":%" PRIu64 ",\"errors\":%" PRIu64 ",\"total_us\":%" PRIu64 ",\"max_us\":%" PRIu64 ",\"p50_us\":%" PRIu64 ",\"p99_us\":%" PRIu64 ",\"histogram\":[",
+                    i == 0 ? "" : ",", s.name, s.calls, s.retries, s.errors, s.total_ns / 1000, s.max_ns / 1000, percentile_us(s, 0.5), percentile_us(s, 0.99));
+            for(auto b = 0; b < latency_buckets; b += 1) {
+                fprintf(out, "%s%" PRIu64, b == 0 ? "" : ",", s.histogram[b]);
+            }
+            fprintf(out, "]}");
+        }
+        fprintf(out, "]");
+        return;
+    }
+
+    fprintf(out, "%-24s %8s %8s %8s %12s %10s %10s %10s\n", "request", "calls", "eintr", "errors", "total(us)", "p50(us)", "p99(us)", "max(us)");
+    for(const auto& s : stats) {
+        fprintf(out, "%-24s %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %12" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+                s.name, s.calls, s.retries, s.errors, s.total_ns / 1000, percentile_us(s, 0.5), percentile_us(s, 0.99), s.max_ns / 1000);
+    }
+}
+} // namespace v4l2
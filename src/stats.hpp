@@ -0,0 +1,26 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace v4l2 {
+// bucket 0 is below 1us, bucket i is [2^(i-1), 2^i) us, the last one is open ended
+constexpr auto latency_buckets = 24;
+
+struct IoctlStats {
+    const char*                           name;
+    uint64_t                              calls;
+    uint64_t                              retries; // EINTR
+    uint64_t                              errors;
+    uint64_t                              total_ns;
+    uint64_t                              max_ns;
+    std::array<uint64_t, latency_buckets> histogram;
+};
+
+// called by xioctl, lock-free and allocation-free
+auto record_ioctl(unsigned long request, uint64_t ns, uint32_t retries, bool error) -> void;
+auto get_ioctl_stats() -> std::vector<IoctlStats>;
+// a human readable table, or a json member "ioctls":[...] to be wrapped in an object by the caller
+auto print_ioctl_stats(FILE* out, bool json) -> void;
+} // namespace v4l2
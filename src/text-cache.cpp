@@ -0,0 +1,66 @@
+#include <charconv>
+
+#include "text-cache.hpp"
+
+namespace vcw {
+auto TextCache::draw_fit_rect(gawl::TextRender& font, gawl::Screen& screen, const gawl::Rectangle& rect, const gawl::Color& color, const std::string_view text, const int size, const gawl::Align align) -> void {
+    lookup.text   = text;
+    lookup.size   = size;
+    lookup.align  = align;
+    lookup.width  = int(rect.width());
+    lookup.height = int(rect.height());
+
+    if(const auto p = index.find(lookup); p != index.end()) {
+        hits += 1;
+        lru.splice(lru.begin(), lru, p->second);
+        const auto& entry = *p->second;
+        font.draw(screen, {rect.a.x + entry.offset.x, rect.a.y + entry.offset.y}, color, text, entry.size);
+        return;
+    }
+    misses += 1;
+
+    auto fit_size = size;
+    auto area     = font.get_rect(screen, {0, 0}, text, fit_size);
+    if(area.width() > rect.width() && area.width() > 0) {
+        fit_size = std::max(1, int(fit_size * rect.width() / area.width()));
+        area     = font.get_rect(screen, {0, 0}, text, fit_size);
+    }
+
+    auto offset = gawl::Point{0, (rect.height() - area.height()) / 2 - area.a.y};
+    switch(align) {
+    case gawl::Align::Left:
+        offset.x = -area.a.x;
+        break;
+    case gawl::Align::Center:
+        offset.x = (rect.width() - area.width()) / 2 - area.a.x;
+        break;
+    case gawl::Align::Right:
+        offset.x = rect.width() - area.b.x;
+        break;
+    }
+
+    if(lru.size() >= capacity) {
+        index.erase(lru.back().key);
+        lru.pop_back();
+    }
+    lru.push_front(Entry{lookup, offset, fit_size});
+    index.emplace(lookup, lru.begin());
+
+    font.draw(screen, {rect.a.x + offset.x, rect.a.y + offset.y}, color, text, fit_size);
+}
+
+auto TextCache::format_number(const int value) -> std::string_view {
+    const auto [ptr, ec] = std::to_chars(number, number + sizeof(number), value);
+    return std::string_view(number, ptr);
+}
+
+auto TextCache::warm_up(gawl::TextRender& font, gawl::Screen& screen, const std::initializer_list<int> sizes) -> void {
+    for(const auto size : sizes) {
+        font.get_rect(screen, {0, 0}, "-0123456789", size);
+    }
+}
+
+TextCache::TextCache(const size_t capacity)
+    : capacity(capacity) {
+}
+} // namespace vcw
@@ -0,0 +1,56 @@
+#pragma once
+#include <list>
+#include <unordered_map>
+
+#include "gawl/textrender.hpp"
+
+namespace vcw {
+// gawl::TextRender keeps glyph textures by itself, but draw_fit_rect lays out and measures the text on every call.
+// this memoizes the layout of each string, keyed by text, size, alignment and box size, with lru eviction.
+class TextCache {
+  private:
+    struct Key {
+        std::string text;
+        int         size;
+        gawl::Align align;
+        int         width;
+        int         height;
+
+        auto operator==(const Key&) const -> bool = default;
+    };
+
+    struct KeyHash {
+        auto operator()(const Key& key) const -> size_t {
+            auto hash = std::hash<std::string>()(key.text);
+            hash ^= (size_t(key.size) << 1) ^ (size_t(key.align) << 9) ^ (size_t(key.width) << 12) ^ (size_t(key.height) << 40);
+            return hash;
+        }
+    };
+
+    struct Entry {
+        Key         key;
+        gawl::Point offset; // text origin from the top-left corner of the box
+        int         size;   // shrunk to fit the box
+    };
+
+    using List = std::list<Entry>;
+
+    List                                             lru;
+    std::unordered_map<Key, List::iterator, KeyHash> index;
+    size_t                                           capacity;
+    Key                                              lookup; // reused to avoid allocating keys on hits
+    char                                             number[16];
+
+  public:
+    size_t hits   = 0;
+    size_t misses = 0;
+
+    auto draw_fit_rect(gawl::TextRender& font, gawl::Screen& screen, const gawl::Rectangle& rect, const gawl::Color& color, std::string_view text, int size, gawl::Align align) -> void;
+    // valid until the next call
+    auto format_number(int value) -> std::string_view;
+    // rasterize digit glyphs ahead, so that slider values never need new glyphs
+    auto warm_up(gawl::TextRender& font, gawl::Screen& screen, std::initializer_list<int> sizes) -> void;
+
+    TextCache(size_t capacity = 512);
+};
+} // namespace vcw
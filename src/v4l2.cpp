@@ -1,32 +1,85 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+
 #include <fcntl.h>
+#include <linux/media.h>
 #include <linux/videodev2.h>
 #include <poll.h>
 #include <sys/ioctl.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "macros/unwrap.hpp"
+#include "stats.hpp"
 #include "v4l2.hpp"
 
 namespace v4l2 {
-template <class... Args>
-auto xioctl(const int fd, const int request, Args&&... args) -> int {
-    auto r = int();
-    do {
-        r = ioctl(fd, request, std::forward<Args>(args)...);
-    } while(r == -1 && errno == EINTR);
+// counts ioctls issued by this thread, to measure enumeration cost
+thread_local auto ioctl_count = size_t(0);
+
+struct KernelBackend : Backend {
+    auto open(const char* const path, const int flags) -> int override {
+        return ::open(path, flags);
+    }
+
+    auto close(const int fd) -> int override {
+        return ::close(fd);
+    }
+
+    auto ioctl(const int fd, const unsigned long request, void* const arg) -> int override {
+        return ::ioctl(fd, request, arg);
+    }
+};
+
+auto kernel_backend = KernelBackend();
+auto backend        = (Backend*)&kernel_backend;
+
+// without NEXT_COMPOUND, compound and array controls are skipped
+constexpr auto next_any_control = V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND;
+
+auto now_ns() -> uint64_t {
+    auto ts = timespec();
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// the only place device ioctls are issued
+auto xioctl(const int fd, const unsigned long request, void* const arg) -> int {
+    const auto begin   = now_ns();
+    auto       retries = uint32_t(0);
+    auto       r       = int();
+    while(true) {
+        ioctl_count += 1;
+        r = backend->ioctl(fd, request, arg);
+        if(r != -1 || errno != EINTR) {
+            break;
+        }
+        retries += 1;
+    }
+    const auto error = errno;
+    record_ioctl(request, now_ns() - begin, retries, r == -1);
+    errno = error;
     return r;
 }
 
-auto enumerate_menu(const int fd, const v4l2_queryctrl& queryctrl) -> std::vector<ControlMenu> {
+// Query is either v4l2_queryctrl or v4l2_query_ext_ctrl
+template <class Query>
+auto enumerate_menu(const int fd, const Query& query) -> std::vector<ControlMenu> {
     auto ret       = std::vector<ControlMenu>();
     auto querymenu = v4l2_querymenu();
 
-    querymenu.id = queryctrl.id;
+    querymenu.id = query.id;
 
-    for(querymenu.index = queryctrl.minimum; querymenu.index <= (uint32_t)queryctrl.maximum; querymenu.index += 1) {
+    for(querymenu.index = query.minimum; querymenu.index <= (uint32_t)query.maximum; querymenu.index += 1) {
         if(xioctl(fd, VIDIOC_QUERYMENU, &querymenu) == 0) {
             auto menu = ControlMenu();
-            memcpy(menu.name, querymenu.name, 32);
+            if(query.type == V4L2_CTRL_TYPE_INTEGER_MENU) {
+                snprintf(menu.name, sizeof(menu.name), "%lld", (long long)querymenu.value);
+            } else {
+                memcpy(menu.name, querymenu.name, 32);
+            }
             menu.index = querymenu.index;
             ret.emplace_back(menu);
         }
@@ -56,82 +109,232 @@ auto control_flags_to_str(const uint32_t flags) -> std::string {
     return ret;
 }
 
-auto query_class_controls(const int fd, const uint32_t control_class, std::vector<Control>& ret) -> void {
-    auto queryctrl = v4l2_queryctrl();
+template <class Query>
+auto append_control(const int fd, const Query& query, const MenuMode menu_mode, std::vector<Control>& ret) -> void {
+    if(query.flags & V4L2_CTRL_FLAG_DISABLED) {
+        return;
+    }
 
-    queryctrl.id = control_class | V4L2_CTRL_FLAG_NEXT_CTRL;
+    auto type   = ControlType();
+    auto layout = PayloadLayout();
+    if constexpr(std::is_same_v<Query, v4l2_query_ext_ctrl>) {
+        if(query.flags & V4L2_CTRL_FLAG_HAS_PAYLOAD || query.type == V4L2_CTRL_TYPE_INTEGER64) {
+            const auto dynamic = bool(query.flags & V4L2_CTRL_FLAG_DYNAMIC_ARRAY);
 
-    while(xioctl(fd, VIDIOC_QUERYCTRL, &queryctrl) == 0) {
-        if(V4L2_CTRL_ID2CLASS(queryctrl.id) != control_class) {
-            break;
-        }
-        if(queryctrl.flags & V4L2_CTRL_FLAG_DISABLED) {
-            continue;
-        }
-
-        do {
-            auto type = ControlType();
-            switch(queryctrl.type) {
-            case V4L2_CTRL_TYPE_INTEGER:
-                type = ControlType::Int;
-                break;
-            case V4L2_CTRL_TYPE_BOOLEAN:
-                type = ControlType::Bool;
-                break;
-            case V4L2_CTRL_TYPE_MENU:
-                type = ControlType::Menu;
-                break;
-            default:
-                continue;
+            layout = PayloadLayout{
+                .type      = query.type,
+                .elem_size = query.elem_size,
+                .elems     = dynamic ? query.dims[0] : query.elems,
+                .dynamic   = dynamic,
+                .pointer   = bool(query.flags & V4L2_CTRL_FLAG_HAS_PAYLOAD),
+            };
+            if(layout.elem_size == 0 || layout.elems == 0) {
+                return;
             }
+        }
+    }
+    switch(query.type) {
+    case V4L2_CTRL_TYPE_INTEGER:
+        type = ControlType::Int;
+        break;
+    case V4L2_CTRL_TYPE_BOOLEAN:
+        type = ControlType::Bool;
+        break;
+    case V4L2_CTRL_TYPE_MENU:
+        type = ControlType::Menu;
+        break;
+    case V4L2_CTRL_TYPE_INTEGER_MENU:
+        type = ControlType::IntMenu;
+        break;
+    case V4L2_CTRL_TYPE_BITMASK:
+        type = ControlType::Bitmask;
+        break;
+    default:
+        // compound types, strings and 64-bit integers
+        if(layout.elem_size == 0) {
+            return;
+        }
+        break;
+    }
+    if(layout.elem_size != 0) {
+        // also arrays of the scalar types above
+        type = layout.pointer ? ControlType::Payload : ControlType::Int64;
+    }
 
-            unwrap(current, get_control(fd, queryctrl.id));
-
-            auto control = Control{
-                .id       = queryctrl.id,
-                .type     = type,
-                .name     = {},
-                .max      = queryctrl.maximum,
-                .min      = queryctrl.minimum,
-                .step     = queryctrl.step,
-                .current  = current,
-                .menus    = {},
-                .ro       = bool(queryctrl.flags & V4L2_CTRL_FLAG_READ_ONLY),
-                .inactive = bool(queryctrl.flags & V4L2_CTRL_FLAG_INACTIVE),
-            };
+    // 64-bit ranges are saturated, they are only meaningful for 32-bit types
+    // the mask of bitmask controls is kept as is
+    const auto saturate = [](const auto value) { return int32_t(std::clamp<int64_t>(value, INT32_MIN, INT32_MAX)); };
+    const auto max      = type == ControlType::Bitmask ? int32_t(uint32_t(query.maximum)) : saturate(query.maximum);
+
+    auto control = Control{
+        .id               = query.id,
+        .type             = type,
+        .name             = {},
+        .max              = max,
+        .min              = saturate(query.minimum),
+        .step             = saturate(query.step),
+        .current          = 0,
+        .menus            = {},
+        .layout           = layout,
+        .ro               = bool(query.flags & V4L2_CTRL_FLAG_READ_ONLY),
+        .wo               = bool(query.flags & V4L2_CTRL_FLAG_WRITE_ONLY),
+        .inactive         = bool(query.flags & V4L2_CTRL_FLAG_INACTIVE),
+        .is_volatile      = bool(query.flags & V4L2_CTRL_FLAG_VOLATILE),
+        .execute_on_write = bool(query.flags & V4L2_CTRL_FLAG_EXECUTE_ON_WRITE),
+        .cached           = false,
+    };
+
+    memcpy(control.name, query.name, 32);
+
+    if(is_menu(type) && menu_mode == MenuMode::Eager) {
+        control.menus = enumerate_menu(fd, query);
+    }
+
+    ret.emplace_back(control);
+}
 
-            memcpy(control.name, queryctrl.name, 32);
+// walks every class in one pass, ordered by id
+// the legacy query cannot describe compound controls
+template <class Query>
+auto enumerate_controls(const int fd, const unsigned long request, const MenuMode menu_mode, std::vector<Control>& ret) -> bool {
+    constexpr auto next_flags = std::is_same_v<Query, v4l2_query_ext_ctrl> ? next_any_control : V4L2_CTRL_FLAG_NEXT_CTRL;
 
-            if(queryctrl.type == V4L2_CTRL_TYPE_MENU) {
-                control.menus = enumerate_menu(fd, queryctrl);
+    auto query = Query();
+
+    query.id = next_flags;
+
+    while(xioctl(fd, request, &query) == 0) {
+        append_control(fd, query, menu_mode, ret);
+        query.id |= next_flags;
+    }
+    return errno != ENOTTY;
+}
+
+auto read_values(const int fd, const std::span<ControlValue> values) -> void {
+    auto ctrls = std::vector<v4l2_ext_control>();
+
+    for(auto begin = size_t(0); begin < values.size();) {
+        const auto control_class = V4L2_CTRL_ID2CLASS(values[begin].id);
+        auto       end           = begin;
+
+        ctrls.clear();
+        for(; end < values.size() && V4L2_CTRL_ID2CLASS(values[end].id) == control_class; end += 1) {
+            auto ctrl = v4l2_ext_control();
+            ctrl.id   = values[end].id;
+            ctrls.push_back(ctrl);
+        }
+
+        auto ext_ctrls       = v4l2_ext_controls();
+        ext_ctrls.ctrl_class = control_class;
+        ext_ctrls.count      = ctrls.size();
+        ext_ctrls.controls   = ctrls.data();
+        if(xioctl(fd, VIDIOC_G_EXT_CTRLS, &ext_ctrls) == 0) {
+            for(auto i = 0u; i < ctrls.size(); i += 1) {
+                values[begin + i].value = ctrls[i].value;
             }
+        } else {
+            // driver without extended controls, or one of them is broken
+            for(auto i = begin; i < end; i += 1) {
+                if(const auto current = get_control(fd, values[i].id)) {
+                    values[i].value = *current;
+                } else {
+                    values[i].id = 0;
+                }
+            }
+        }
+        begin = end;
+    }
+}
 
-            ret.emplace_back(control);
+auto read_values(const int fd, std::vector<Control>& controls) -> void {
+    auto values  = std::vector<ControlValue>();
+    auto indices = std::vector<size_t>();
+    for(auto i = 0u; i < controls.size(); i += 1) {
+        if(!controls[i].wo && !has_payload(controls[i].type)) {
+            values.push_back({controls[i].id, 0});
+            indices.push_back(i);
+        }
+    }
+    read_values(fd, values);
+    for(auto i = 0u; i < values.size(); i += 1) {
+        if(values[i].id != 0) {
+            controls[indices[i]].current = values[i].value;
+        } else {
+            controls[indices[i]].id = 0;
+        }
+    }
+    std::erase_if(controls, [](const Control& ctrl) { return ctrl.id == 0; });
+}
+
+auto query_controls(const int fd, const MenuMode menu_mode, size_t* const ioctls) -> std::vector<Control> {
+    const auto ioctls_begin = ioctl_count;
+
+    auto ret = std::vector<Control>();
+    if(!enumerate_controls<v4l2_query_ext_ctrl>(fd, VIDIOC_QUERY_EXT_CTRL, menu_mode, ret)) {
+        // kernels older than 3.19
+        enumerate_controls<v4l2_queryctrl>(fd, VIDIOC_QUERYCTRL, menu_mode, ret);
+    }
+    read_values(fd, ret);
 
-        } while(0);
-        queryctrl.id |= V4L2_CTRL_FLAG_NEXT_CTRL;
+    if(ioctls != nullptr) {
+        *ioctls = ioctl_count - ioctls_begin;
     }
+    return ret;
+}
+
+auto set_backend(Backend* const new_backend) -> void {
+    backend = new_backend != nullptr ? new_backend : &kernel_backend;
 }
 
-auto query_controls(const int fd) -> std::vector<Control> {
+auto open_device(const char* const path) -> int {
+    return backend->open(path, O_RDWR | O_CLOEXEC);
+}
+
+auto close_device(const int fd) -> void {
+    backend->close(fd);
+}
+
+auto query_control(const int fd, const uint32_t id) -> std::optional<Control> {
+    auto query = v4l2_query_ext_ctrl();
+    query.id   = id;
+    ensure(xioctl(fd, VIDIOC_QUERY_EXT_CTRL, &query) == 0);
     auto ret = std::vector<Control>();
-    query_class_controls(fd, V4L2_CTRL_CLASS_USER, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_CODEC, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_CAMERA, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_FM_TX, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_FLASH, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_JPEG, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_IMAGE_SOURCE, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_IMAGE_PROC, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_DV, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_FM_RX, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_RF_TUNER, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_DETECT, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_CODEC_STATELESS, ret);
-    query_class_controls(fd, V4L2_CTRL_CLASS_COLORIMETRY, ret);
+    append_control(fd, query, MenuMode::Lazy, ret);
+    // disabled or unsupported
+    ensure(!ret.empty());
+    return std::move(ret.front());
+}
+
+auto next_control_id(const int fd, const uint32_t id) -> std::optional<uint32_t> {
+    auto query = v4l2_query_ext_ctrl();
+    query.id   = id | next_any_control;
+    if(xioctl(fd, VIDIOC_QUERY_EXT_CTRL, &query) != 0) {
+        return std::nullopt;
+    }
+    return query.id;
+}
+
+auto query_identity(const int fd) -> std::optional<DeviceIdentity> {
+    auto cap = v4l2_capability();
+    ensure(xioctl(fd, VIDIOC_QUERYCAP, &cap) == 0);
+
+    auto ret = DeviceIdentity();
+    memcpy(ret.driver, cap.driver, sizeof(ret.driver));
+    memcpy(ret.card, cap.card, sizeof(ret.card));
+    memcpy(ret.bus_info, cap.bus_info, sizeof(ret.bus_info));
+    ret.version = cap.version;
     return ret;
 }
 
+auto query_menu(const int fd, const uint32_t id, const ControlType type, const int32_t min, const int32_t max) -> std::vector<ControlMenu> {
+    auto query    = v4l2_queryctrl();
+    query.id      = id;
+    query.type    = type == ControlType::IntMenu ? V4L2_CTRL_TYPE_INTEGER_MENU : V4L2_CTRL_TYPE_MENU;
+    query.minimum = min;
+    query.maximum = max;
+    return enumerate_menu(fd, query);
+}
+
 auto get_control(const int fd, const uint32_t id) -> std::optional<int32_t> {
     auto control = v4l2_control();
     control.id   = id;
@@ -148,4 +351,204 @@ auto set_control(const int fd, const uint32_t id, const int32_t value) -> bool {
 
     return xioctl(fd, VIDIOC_S_CTRL, &control) == 0;
 }
+
+auto make_payload(const uint32_t id, const PayloadLayout& layout) -> Payload {
+    const auto size = layout.elem_size * layout.elems;
+    return Payload{.id = id, .layout = layout, .data = std::vector<std::byte>(size), .size = size};
+}
+
+auto to_ext_control(const Payload& payload, const uint32_t size) -> v4l2_ext_control {
+    auto ctrl = v4l2_ext_control();
+    ctrl.id   = payload.id;
+    if(payload.layout.pointer) {
+        ctrl.size = size;
+        ctrl.ptr  = (void*)payload.data.data();
+    } else {
+        memcpy(&ctrl.value64, payload.data.data(), sizeof(ctrl.value64));
+    }
+    return ctrl;
+}
+
+auto ext_control_ioctl(const int fd, const unsigned long request, v4l2_ext_control& ctrl) -> bool {
+    auto ext_ctrls       = v4l2_ext_controls();
+    ext_ctrls.ctrl_class = V4L2_CTRL_ID2CLASS(ctrl.id);
+    ext_ctrls.count      = 1;
+    ext_ctrls.controls   = &ctrl;
+    return xioctl(fd, request, &ext_ctrls) == 0;
+}
+
+auto get_payload(const int fd, Payload& payload) -> bool {
+    auto ctrl = to_ext_control(payload, payload.data.size());
+    ensure(ext_control_ioctl(fd, VIDIOC_G_EXT_CTRLS, ctrl));
+    if(payload.layout.pointer) {
+        payload.size = std::min<uint32_t>(ctrl.size, payload.data.size());
+    } else {
+        memcpy(payload.data.data(), &ctrl.value64, sizeof(ctrl.value64));
+    }
+    return true;
+}
+
+auto set_payload(const int fd, const Payload& payload) -> bool {
+    auto ctrl = to_ext_control(payload, payload.size);
+    return ext_control_ioctl(fd, VIDIOC_S_EXT_CTRLS, ctrl);
+}
+
+// values followed by payloads
+auto to_ext_controls(const std::span<const ControlValue> values, const std::span<const Payload* const> payloads) -> std::vector<v4l2_ext_control> {
+    auto ret = std::vector<v4l2_ext_control>(values.size());
+    for(auto i = 0u; i < values.size(); i += 1) {
+        ret[i].id    = values[i].id;
+        ret[i].value = values[i].value;
+    }
+    for(const auto payload : payloads) {
+        ret.push_back(to_ext_control(*payload, payload->size));
+    }
+    return ret;
+}
+
+auto set_controls_fallback(const int fd, const std::span<const ControlValue> values, const std::span<const Payload* const> payloads) -> BatchResult {
+    for(auto i = 0u; i < values.size(); i += 1) {
+        if(!set_control(fd, values[i].id, values[i].value)) {
+            return {false, i};
+        }
+    }
+    // fails as well, payload controls need the extended ioctls
+    for(auto i = 0u; i < payloads.size(); i += 1) {
+        if(!set_payload(fd, *payloads[i])) {
+            return {false, values.size() + i};
+        }
+    }
+    return {true, values.size() + payloads.size()};
+}
+
+auto set_controls(const int fd, const std::span<const ControlValue> values, const std::span<const Payload* const> payloads) -> BatchResult {
+    const auto unsorted = to_ext_controls(values, payloads);
+
+    // sort by class, keeping the requested order inside each class
+    auto order = std::vector<size_t>(unsorted.size());
+    for(auto i = 0u; i < order.size(); i += 1) {
+        order[i] = i;
+    }
+    std::ranges::stable_sort(order, {}, [&unsorted](const size_t i) { return V4L2_CTRL_ID2CLASS(unsorted[i].id); });
+
+    auto ctrls = std::vector<v4l2_ext_control>(unsorted.size());
+    for(auto i = 0u; i < order.size(); i += 1) {
+        ctrls[i] = unsorted[order[i]];
+    }
+
+    // returns false with error_index filled on failure
+    const auto apply = [&](const unsigned long request, BatchResult& result) -> bool {
+        for(auto begin = size_t(0); begin < ctrls.size();) {
+            const auto control_class = V4L2_CTRL_ID2CLASS(ctrls[begin].id);
+            auto       end           = begin + 1;
+            while(end < ctrls.size() && V4L2_CTRL_ID2CLASS(ctrls[end].id) == control_class) {
+                end += 1;
+            }
+
+            auto ext_ctrls       = v4l2_ext_controls();
+            ext_ctrls.ctrl_class = control_class;
+            ext_ctrls.count      = end - begin;
+            ext_ctrls.controls   = &ctrls[begin];
+            if(xioctl(fd, request, &ext_ctrls) != 0) {
+                result = {false, ext_ctrls.error_idx < ext_ctrls.count ? order[begin + ext_ctrls.error_idx] : ctrls.size()};
+                return false;
+            }
+            begin = end;
+        }
+        return true;
+    };
+
+    auto result = BatchResult{true, ctrls.size()};
+    if(!apply(VIDIOC_TRY_EXT_CTRLS, result)) {
+        if(errno == ENOTTY) {
+            // driver without extended control support
+            return set_controls_fallback(fd, values, payloads);
+        }
+        return result;
+    }
+    apply(VIDIOC_S_EXT_CTRLS, result);
+    return result;
+}
+
+auto set_request_controls(const int fd, const int request_fd, const std::span<const ControlValue> values, const std::span<const Payload* const> payloads) -> BatchResult {
+    // classes can be mixed when which is set
+    auto ctrls = to_ext_controls(values, payloads);
+
+    auto ext_ctrls       = v4l2_ext_controls();
+    ext_ctrls.which      = V4L2_CTRL_WHICH_REQUEST_VAL;
+    ext_ctrls.request_fd = request_fd;
+    ext_ctrls.count      = ctrls.size();
+    ext_ctrls.controls   = ctrls.data();
+    if(xioctl(fd, VIDIOC_S_EXT_CTRLS, &ext_ctrls) != 0) {
+        return {false, ext_ctrls.error_idx < ext_ctrls.count ? ext_ctrls.error_idx : ctrls.size()};
+    }
+    return {true, ctrls.size()};
+}
+
+auto alloc_request(const int media_fd) -> std::optional<int> {
+    auto request_fd = -1;
+    ensure(xioctl(media_fd, MEDIA_IOC_REQUEST_ALLOC, &request_fd) == 0);
+    return request_fd;
+}
+
+auto queue_request(const int request_fd) -> bool {
+    return xioctl(request_fd, MEDIA_REQUEST_IOC_QUEUE, nullptr) == 0;
+}
+
+auto reinit_request(const int request_fd) -> bool {
+    return xioctl(request_fd, MEDIA_REQUEST_IOC_REINIT, nullptr) == 0;
+}
+
+auto subscribe_control_events(const int fd, const uint32_t id) -> bool {
+    auto sub  = v4l2_event_subscription();
+    sub.type  = V4L2_EVENT_CTRL;
+    sub.id    = id;
+    // without feedback, changes to other controls of a cluster caused by our own write would not be reported
+    sub.flags = V4L2_EVENT_SUB_FL_SEND_INITIAL | V4L2_EVENT_SUB_FL_ALLOW_FEEDBACK;
+    return xioctl(fd, VIDIOC_SUBSCRIBE_EVENT, &sub) == 0;
+}
+
+auto wait_events(const int fd, const int cancel_fd) -> bool {
+    auto fds = std::array{
+        pollfd{.fd = fd, .events = POLLPRI, .revents = 0},
+        pollfd{.fd = cancel_fd, .events = POLLIN, .revents = 0},
+    };
+    while(true) {
+        if(poll(fds.data(), fds.size(), -1) == -1) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if(fds[1].revents != 0) {
+            return false;
+        }
+        if(fds[0].revents & POLLPRI) {
+            return true;
+        }
+        if(fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            return false;
+        }
+    }
+}
+
+auto dequeue_event(const int fd) -> std::optional<ControlEvent> {
+    auto event = v4l2_event();
+    if(xioctl(fd, VIDIOC_DQEVENT, &event) != 0 || event.type != V4L2_EVENT_CTRL) {
+        return std::nullopt;
+    }
+    const auto& ctrl = event.u.ctrl;
+    return ControlEvent{
+        .id           = event.id,
+        .changes      = ctrl.changes,
+        .value        = ctrl.value,
+        .max          = ctrl.maximum,
+        .min          = ctrl.minimum,
+        .step         = ctrl.step,
+        .ro           = bool(ctrl.flags & V4L2_CTRL_FLAG_READ_ONLY),
+        .inactive     = bool(ctrl.flags & V4L2_CTRL_FLAG_INACTIVE),
+        .timestamp_ns = uint64_t(event.timestamp.tv_sec) * 1'000'000'000 + event.timestamp.tv_nsec,
+    };
+}
+
 } // namespace v4l2
@@ -1,5 +1,8 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <optional>
+#include <span>
 #include <vector>
 
 namespace v4l2 {
@@ -7,6 +10,28 @@ enum class ControlType {
     Int,
     Bool,
     Menu,
+    IntMenu, // menu labels are 64-bit integers
+    Bitmask, // max holds the valid bits
+    Int64,   // value is a Payload
+    Payload, // compound and array controls, value is a Payload
+};
+
+// whether values of the type do not fit in Control::current
+inline auto has_payload(const ControlType type) -> bool {
+    return type == ControlType::Int64 || type == ControlType::Payload;
+}
+
+inline auto is_menu(const ControlType type) -> bool {
+    return type == ControlType::Menu || type == ControlType::IntMenu;
+}
+
+// shape of Payload values, zero for other types
+struct PayloadLayout {
+    uint32_t type;      // V4L2_CTRL_TYPE_*
+    uint32_t elem_size; // in bytes
+    uint32_t elems;     // the maximum for dynamic arrays
+    bool     dynamic;   // element count can change
+    bool     pointer;   // passed through ptr, otherwise in value64
 };
 
 struct ControlMenu {
@@ -23,13 +48,119 @@ struct Control {
     int32_t                  step;
     int32_t                  current;
     std::vector<ControlMenu> menus;
+    PayloadLayout            layout;
 
     // flags
     bool ro;
+    bool wo;
     bool inactive;
+    bool is_volatile;      // changed by the device itself
+    bool execute_on_write; // writing has side effects even if the value is the same, e.g. buttons
+
+    // loaded from the descriptor cache, the range may have changed since, e.g. an exposure limit that depends on the frame rate
+    bool cached;
+};
+
+// menu labels can be left unresolved, and then menus of menu controls are empty
+enum class MenuMode {
+    Eager,
+    Lazy,
+};
+
+struct DeviceIdentity {
+    char     driver[16];
+    char     card[32];
+    char     bus_info[32];
+    uint32_t version;
+};
+
+struct ControlValue {
+    uint32_t id;
+    int32_t  value;
+};
+
+struct ControlEvent {
+    uint32_t id;
+    uint32_t changes; // V4L2_EVENT_CTRL_CH_*
+    int32_t  value;
+    int32_t  max;
+    int32_t  min;
+    int32_t  step;
+    bool     ro;
+    bool     inactive;
+    uint64_t timestamp_ns; // CLOCK_MONOTONIC, set by the driver
+};
+
+// value of an Int64 or Payload control
+// data is sized for the largest value once, and reused by every get_payload()/set_payload()
+struct Payload {
+    uint32_t               id;
+    PayloadLayout          layout;
+    std::vector<std::byte> data;
+    uint32_t               size; // bytes in use, less than data.size() for short dynamic arrays
+};
+
+auto make_payload(uint32_t id, const PayloadLayout& layout) -> Payload;
+
+struct BatchResult {
+    bool ok;
+    // index of the rejected value, or the number of values if the error is not specific to a control
+    size_t error_index;
 };
 
-auto query_controls(int fd) -> std::vector<Control>;
+// every device access goes through a backend, so that the kernel can be replaced with a fake device
+struct Backend {
+    virtual auto open(const char* path, int flags) -> int               = 0;
+    virtual auto close(int fd) -> int                                   = 0;
+    virtual auto ioctl(int fd, unsigned long request, void* arg) -> int = 0;
+
+    virtual ~Backend() {}
+};
+
+// nullptr to restore the kernel backend
+auto set_backend(Backend* backend) -> void;
+auto open_device(const char* path) -> int;
+auto close_device(int fd) -> void;
+
+// enumerates every control class in a single pass
+// ioctls receives the number of ioctls issued, if not null
+auto query_controls(int fd, MenuMode menu_mode, size_t* ioctls = nullptr) -> std::vector<Control>;
+// fills current of each control, one VIDIOC_G_EXT_CTRLS per class
+// controls must be sorted by id, controls that fail to read are removed
+// write-only and payload controls are left as 0
+auto read_values(int fd, std::vector<Control>& controls) -> void;
+// same as above, but the ids of values that fail to read are set to 0
+auto read_values(int fd, std::span<ControlValue> values) -> void;
+// descriptor of a single control, menus are left unresolved
+// fails on drivers without VIDIOC_QUERY_EXT_CTRL
+auto query_control(int fd, uint32_t id) -> std::optional<Control>;
+// id of the first control after id, including unsupported ones
+auto next_control_id(int fd, uint32_t id) -> std::optional<uint32_t>;
+auto query_identity(int fd) -> std::optional<DeviceIdentity>;
+// labels of IntMenu controls are their values
+auto query_menu(int fd, uint32_t id, ControlType type, int32_t min, int32_t max) -> std::vector<ControlMenu>;
 auto get_control(int fd, uint32_t id) -> std::optional<int32_t>;
 auto set_control(int fd, uint32_t id, int32_t value) -> bool;
+// payload.size is updated to the size reported by the driver
+auto get_payload(int fd, Payload& payload) -> bool;
+auto set_payload(int fd, const Payload& payload) -> bool;
+// all-or-nothing, one VIDIOC_S_EXT_CTRLS per control class
+// payloads go in the same batch, error_index counts them after values
+auto set_controls(int fd, std::span<const ControlValue> values, std::span<const Payload* const> payloads = {}) -> BatchResult;
+// stores values in a media request, they are applied when the request is processed
+auto set_request_controls(int fd, int request_fd, std::span<const ControlValue> values, std::span<const Payload* const> payloads = {}) -> BatchResult;
+
+// media request api, fds are closed with close_device
+auto alloc_request(int media_fd) -> std::optional<int>;
+auto queue_request(int request_fd) -> bool;
+auto reinit_request(int request_fd) -> bool;
+
+// the current state is delivered as an initial event
+// changes made through this fd are reported too
+auto subscribe_control_events(int fd, uint32_t id) -> bool;
+// blocks until fd has pending events or cancel_fd becomes readable
+// returns false if cancelled
+auto wait_events(int fd, int cancel_fd) -> bool;
+// returns nullopt when no events are left
+auto dequeue_event(int fd) -> std::optional<ControlEvent>;
 } // namespace v4l2
@@ -0,0 +1,173 @@
+#include <charconv>
+#include <cstring>
+
+#include <linux/videodev2.h>
+
+#include "macros/unwrap.hpp"
+#include "util/charconv.hpp"
+#include "value-text.hpp"
+
+namespace v4l2 {
+namespace {
+enum class ElementKind {
+    Signed,
+    Unsigned,
+    String,
+    Bytes,
+};
+
+auto get_element_kind(const PayloadLayout& layout) -> ElementKind {
+    switch(layout.type) {
+    case V4L2_CTRL_TYPE_INTEGER:
+    case V4L2_CTRL_TYPE_BOOLEAN:
+    case V4L2_CTRL_TYPE_MENU:
+    case V4L2_CTRL_TYPE_INTEGER_MENU:
+    case V4L2_CTRL_TYPE_INTEGER64:
+        return ElementKind::Signed;
+    case V4L2_CTRL_TYPE_BITMASK:
+    case V4L2_CTRL_TYPE_U8:
+    case V4L2_CTRL_TYPE_U16:
+    case V4L2_CTRL_TYPE_U32:
+        return ElementKind::Unsigned;
+    case V4L2_CTRL_TYPE_STRING:
+        return ElementKind::String;
+    default:
+        return ElementKind::Bytes;
+    }
+}
+
+constexpr auto hex_digits = std::string_view("0123456789abcdef");
+
+template <class T>
+auto load(const std::byte* const ptr) -> T {
+    auto value = T();
+    memcpy(&value, ptr, sizeof(T));
+    return value;
+}
+
+template <class T>
+auto store(std::byte* const ptr, const std::string_view str) -> bool {
+    unwrap(value, from_chars<T>(str));
+    memcpy(ptr, &value, sizeof(T));
+    return true;
+}
+
+template <class T>
+auto append_number(const T value, std::string& out) -> void {
+    char buf[24];
+    out.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+}
+
+auto append_element(const ElementKind kind, const uint32_t size, const std::byte* const ptr, std::string& out) -> void {
+    switch(kind) {
+    case ElementKind::Signed:
+        append_number(size == 8 ? load<int64_t>(ptr) : load<int32_t>(ptr), out);
+        break;
+    case ElementKind::Unsigned:
+        append_number(size == 1 ? load<uint8_t>(ptr) : size == 2 ? load<uint16_t>(ptr) : load<uint32_t>(ptr), out);
+        break;
+    case ElementKind::String:
+        out.append((const char*)ptr, strnlen((const char*)ptr, size));
+        break;
+    case ElementKind::Bytes:
+        out += "0x";
+        for(auto i = 0u; i < size; i += 1) {
+            out += hex_digits[uint8_t(ptr[i]) >> 4];
+            out += hex_digits[uint8_t(ptr[i]) & 0x0f];
+        }
+        break;
+    }
+}
+
+auto store_element(const ElementKind kind, const uint32_t size, std::byte* const ptr, const std::string_view str) -> bool {
+    switch(kind) {
+    case ElementKind::Signed:
+        return size == 8 ? store<int64_t>(ptr, str) : store<int32_t>(ptr, str);
+    case ElementKind::Unsigned:
+        return size == 1 ? store<uint8_t>(ptr, str) : size == 2 ? store<uint16_t>(ptr, str) : store<uint32_t>(ptr, str);
+    case ElementKind::String:
+        // room for the terminator
+        ensure(str.size() < size);
+        memcpy(ptr, str.data(), str.size());
+        memset(ptr + str.size(), 0, size - str.size());
+        return true;
+    case ElementKind::Bytes:
+        ensure(str.starts_with("0x") && str.size() == 2 + size * 2);
+        for(auto i = 0u; i < size; i += 1) {
+            auto       byte = uint8_t();
+            const auto hex  = str.data() + 2 + i * 2;
+            ensure(std::from_chars(hex, hex + 2, byte, 16).ptr == hex + 2);
+            ptr[i] = std::byte(byte);
+        }
+        return true;
+    }
+    return false;
+}
+} // namespace
+
+auto format_value(const ControlType type, const int32_t value, std::string& out) -> void {
+    if(type == ControlType::Bitmask) {
+        char buf[16];
+        out.append(buf, snprintf(buf, sizeof(buf), "0x%08x", uint32_t(value)));
+    } else {
+        append_number(value, out);
+    }
+}
+
+auto format_payload(const Payload& payload, std::string& out, const size_t limit) -> void {
+    const auto& layout = payload.layout;
+    const auto  kind   = get_element_kind(layout);
+    const auto  count  = payload.size / layout.elem_size;
+    for(auto i = size_t(0); i < count && i < limit; i += 1) {
+        if(i != 0) {
+            out += ',';
+        }
+        append_element(kind, layout.elem_size, payload.data.data() + i * layout.elem_size, out);
+    }
+    if(count > limit) {
+        out += ",...";
+    }
+}
+
+auto parse_value(const ControlType type, const std::string_view str) -> std::optional<int32_t> {
+    if(type == ControlType::Bitmask) {
+        auto bits = uint32_t();
+        if(str.starts_with("0x")) {
+            // no digit or overflow is reported through ec only, ptr may still reach the end
+            const auto end       = str.data() + str.size();
+            const auto [ptr, ec] = std::from_chars(str.data() + 2, end, bits, 16);
+            ensure(ec == std::errc() && ptr == end);
+        } else {
+            unwrap(value, from_chars<uint32_t>(str));
+            bits = value;
+        }
+        return int32_t(bits);
+    }
+    return from_chars<int32_t>(str);
+}
+
+auto parse_payload(std::string_view str, Payload& payload) -> bool {
+    const auto& layout = payload.layout;
+    const auto  kind   = get_element_kind(layout);
+    auto        count  = uint32_t(0);
+    if(kind == ElementKind::String && layout.elems == 1) {
+        // a single string may contain ','
+        ensure(store_element(kind, layout.elem_size, payload.data.data(), str));
+        count = 1;
+    } else if(!str.empty()) {
+        while(true) {
+            ensure(count < layout.elems, "too many elements");
+            const auto pos = str.find(',');
+            ensure(store_element(kind, layout.elem_size, payload.data.data() + count * layout.elem_size, str.substr(0, pos)));
+            count += 1;
+            if(pos == str.npos) {
+                break;
+            }
+            str = str.substr(pos + 1);
+        }
+    }
+    ensure(layout.dynamic || count == layout.elems, "element count mismatch");
+    payload.size = count * layout.elem_size;
+    return true;
+}
+} // namespace v4l2
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+
+#include "v4l2.hpp"
+
+namespace v4l2 {
+// text form of control values, shared by the command line, scripts and the window
+//   Bitmask: 0x-prefixed hex, decimal is also accepted
+//   Payload: elements separated by ','
+//            integers in decimal, strings as is, other compound types as 0x-prefixed bytes in memory order
+//   others:  decimal
+// appends the value to out
+auto format_value(ControlType type, int32_t value, std::string& out) -> void;
+// at most limit elements are appended, followed by "..." if there are more
+auto format_payload(const Payload& payload, std::string& out, size_t limit = ~size_t(0)) -> void;
+auto parse_value(ControlType type, std::string_view str) -> std::optional<int32_t>;
+// parses into the buffer of payload and sets payload.size, nothing is allocated
+// fixed arrays need every element, dynamic arrays up to layout.elems
+auto parse_payload(std::string_view str, Payload& payload) -> bool;
+} // namespace v4l2
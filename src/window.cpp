@@ -1,9 +1,13 @@
+#include <fcntl.h>
+
 #include "window.hpp"
+#include "coop/thread.hpp"
 #include "gawl/application.hpp"
 #include "gawl/fc.hpp"
 #include "gawl/misc.hpp"
 #include "gawl/window.hpp"
 #include "macros/unwrap.hpp"
+#include "startup.hpp"
 
 namespace vcw {
 namespace {
@@ -14,9 +18,39 @@ constexpr auto color_front          = gawl::Color{1. * 0xC5 / 0xFF, 1. * 0xC8 /
 constexpr auto color_front_focus    = gawl::Color{1. * 0xA5 / 0xFF, 1. * 0xA8 / 0xFF, 1. * 0xA6 / 0xFF, 1};
 constexpr auto color_front_inactive = gawl::Color{1. * 0x69 / 0xFF, 1. * 0x6A / 0xFF, 1. * 0x6B / 0xFF, 1};
 constexpr auto slider_button_width  = 60.0;
+constexpr auto scroll_speed         = 2.0;
+constexpr auto hud_width            = 320.0;
+constexpr auto color_hud            = gawl::Color{1, 1, 0.4, 1};
+constexpr auto color_hud_back       = gawl::Color{0, 0, 0, 0.8};
 // constexpr auto slider_button_height = row_height * 0.9;
+
+auto find_font() -> std::optional<std::string> {
+    auto path = gawl::find_fontpath_from_name("Noto Sans CJK JP");
+    startup::mark("font resolved");
+    if(!path) {
+        return path;
+    }
+    // pull the font into the page cache before the renderer opens it
+    if(const auto fd = open(path->data(), O_RDONLY | O_CLOEXEC); fd != -1) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+    return path;
+}
 } // namespace
 
+auto Callbacks::get_visible_rows() const -> std::pair<size_t, size_t> {
+    const auto [width, height] = window->get_window_size();
+    const auto first           = std::min(size_t(scroll / row_height), rows.size());
+    const auto last            = std::min(size_t((scroll + height) / row_height) + 1, rows.size());
+    return {first, last};
+}
+
+auto Callbacks::clamp_scroll() -> void {
+    const auto [width, height] = window->get_window_size();
+    scroll                     = std::clamp(scroll, 0.0, std::max(0.0, rows.size() * row_height - height));
+}
+
 auto Callbacks::calc_button_center(Control& ctrl) const -> double {
     const auto [width, height]  = window->get_window_size();
     const auto [min, max, step] = ctrl.get_range();
@@ -25,6 +59,10 @@ auto Callbacks::calc_button_center(Control& ctrl) const -> double {
     return button_center;
 }
 
+auto Callbacks::draw_text(const gawl::Rectangle& rect, const gawl::Color& color, const std::string_view text, const int size, const gawl::Align align) -> void {
+    text_cache.draw_fit_rect(font, *window, rect, color, text, size, align);
+}
+
 auto Callbacks::draw_control(Control& ctrl, const double y) -> void {
     const auto [width, height] = window->get_window_size();
     const auto div_rect        = gawl::Rectangle{{0, y}, {1. * width, y + row_height - row_separetor_height}};
@@ -36,26 +74,26 @@ auto Callbacks::draw_control(Control& ctrl, const double y) -> void {
     switch(ctrl.get_type()) {
     case ControlType::Int: {
         const auto [min, max, step] = ctrl.get_range();
-        font.draw_fit_rect(*window, div_rect, label_color, ctrl.get_label(), int(div_rect.height() * 0.6), gawl::Align::Center);
-        font.draw_fit_rect(*window, div_rect, label_color, std::to_string(min), int(div_rect.height() * 0.5), gawl::Align::Left);
-        font.draw_fit_rect(*window, div_rect, label_color, std::to_string(max), int(div_rect.height() * 0.5), gawl::Align::Right);
+        draw_text(div_rect, label_color, ctrl.get_label(), int(div_rect.height() * 0.6), gawl::Align::Center);
+        draw_text(div_rect, label_color, text_cache.format_number(min), int(div_rect.height() * 0.5), gawl::Align::Left);
+        draw_text(div_rect, label_color, text_cache.format_number(max), int(div_rect.height() * 0.5), gawl::Align::Right);
 
         const auto button_center = calc_button_center(ctrl);
         const auto button_rect   = gawl::Rectangle{
               {button_center - slider_button_width / 2, div_rect.a.y},
               {button_center + slider_button_width / 2, div_rect.a.y + div_rect.height()}};
         gawl::draw_rect(*window, button_rect, &ctrl == focus_control ? color_front_focus : color_front);
-        font.draw_fit_rect(*window, button_rect, label_color, std::to_string(current), int(div_rect.height() * 0.6), gawl::Align::Center);
+        draw_text(button_rect, label_color, text_cache.format_number(current), int(div_rect.height() * 0.6), gawl::Align::Center);
     } break;
     case ControlType::Bool: {
         if(current) {
             gawl::draw_rect(*window, {div_rect.a, {div_rect.b.x / 2, div_rect.b.y}}, color_front);
-            font.draw_fit_rect(*window, div_rect, label_color, "On", int(div_rect.height() * 0.5), gawl::Align::Left);
+            draw_text(div_rect, label_color, "On", int(div_rect.height() * 0.5), gawl::Align::Left);
         } else {
             gawl::draw_rect(*window, {{div_rect.b.x / 2, div_rect.a.y}, div_rect.b}, color_front);
-            font.draw_fit_rect(*window, div_rect, label_color, "Off", int(div_rect.height() * 0.5), gawl::Align::Right);
+            draw_text(div_rect, label_color, "Off", int(div_rect.height() * 0.5), gawl::Align::Right);
         }
-        font.draw_fit_rect(*window, div_rect, label_color, ctrl.get_label(), int(div_rect.height() * 0.6), gawl::Align::Center);
+        draw_text(div_rect, label_color, ctrl.get_label(), int(div_rect.height() * 0.6), gawl::Align::Center);
     } break;
     case ControlType::Menu: {
         const auto menu_width = div_rect.width() / (ctrl.get_menu_size());
@@ -65,10 +103,14 @@ auto Callbacks::draw_control(Control& ctrl, const double y) -> void {
             if(ctrl.get_current() == ctrl.get_menu_value(i)) {
                 gawl::draw_rect(*window, menu_rect, color_front);
             }
-            font.draw_fit_rect(*window, menu_rect, label_color, ctrl.get_menu_label(i), int(div_rect.height() * 0.5), gawl::Align::Center);
+            draw_text(menu_rect, label_color, ctrl.get_menu_label(i), int(div_rect.height() * 0.5), gawl::Align::Center);
             gawl::draw_rect(*window, {{x, y}, {x + 2, y + div_rect.height()}}, color_front);
         }
     } break;
+    case ControlType::Text: {
+        draw_text(div_rect, color_front_inactive, ctrl.get_label(), int(div_rect.height() * 0.6), gawl::Align::Left);
+        draw_text(div_rect, color_front_inactive, ctrl.get_text(), int(div_rect.height() * 0.5), gawl::Align::Right);
+    } break;
     }
 }
 
@@ -78,7 +120,16 @@ auto Callbacks::draw_label(const std::string_view text, const bool is_quit, cons
 
     gawl::draw_rect(*window, div_rect, color_back);
     const auto color = is_quit ? gawl::Color{1, 0, 0, 1} : gawl::Color{1, 1, 1, 1};
-    font.draw_fit_rect(*window, div_rect, color, text, int(row_height * 0.6), gawl::Align::Center);
+    draw_text(div_rect, color, text, int(row_height * 0.6), gawl::Align::Center);
+}
+
+auto Callbacks::draw_tab(const Tab& tab, const double y) -> void {
+    const auto [width, height] = window->get_window_size();
+    const auto div_rect        = gawl::Rectangle{{0, y}, {1. * width, y + row_height - row_separetor_height}};
+
+    gawl::draw_rect(*window, div_rect, tab.selected ? color_front_inactive : color_back);
+    gawl::draw_rect(*window, {{0, y + row_height - row_separetor_height}, {1. * width, y + row_height}}, color_front);
+    draw_text(div_rect, {1, 1, 1, 1}, tab.text, int(div_rect.height() * 0.6), gawl::Align::Left);
 }
 
 auto Callbacks::draw_row(Row& row, const double y) -> void {
@@ -89,12 +140,41 @@ auto Callbacks::draw_row(Row& row, const double y) -> void {
     case Row::index_of<Label>:
         draw_label(row.as<Label>().text, false, y);
         break;
+    case Row::index_of<Tab>:
+        draw_tab(row.as<Tab>(), y);
+        break;
     case Row::index_of<QuitButton>:
         draw_label("Quit", false, y);
         break;
     }
 }
 
+auto Callbacks::draw_row_badge(const Control& ctrl, const double y) -> void {
+    const auto badge = hud.format_row_badge(&ctrl);
+    if(badge.empty()) {
+        return;
+    }
+    // in the gap left of the maximum label of sliders, which fits in two button widths
+    const auto [width, height] = window->get_window_size();
+    const auto rect            = gawl::Rectangle{{width - slider_button_width * 4, y}, {width - slider_button_width * 2, y + row_height * 0.4}};
+    draw_text(rect, color_hud, badge, int(row_height * 0.35), gawl::Align::Right);
+}
+
+auto Callbacks::draw_hud() -> void {
+    const auto [width, height] = window->get_window_size();
+    const auto line_height     = row_height * 0.6;
+    auto       lines           = size_t(0);
+    while(!hud.format_line(lines).empty()) {
+        lines += 1;
+    }
+    const auto rect = gawl::Rectangle{{width - hud_width, 0}, {1. * width, line_height * lines}};
+    gawl::draw_rect(*window, rect, color_hud_back);
+    for(auto i = 0u; i < lines; i += 1) {
+        const auto line_rect = gawl::Rectangle{{rect.a.x + 4, line_height * i}, {rect.b.x, line_height * (i + 1)}};
+        draw_text(line_rect, color_hud, hud.format_line(i), int(line_height * 0.8), gawl::Align::Left);
+    }
+}
+
 auto Callbacks::proc_control_click(Control& ctrl) -> void {
     if(!ctrl.is_active()) {
         return;
@@ -118,6 +198,8 @@ auto Callbacks::proc_control_click(Control& ctrl) -> void {
         callbacks->set_control_value(ctrl, ctrl.get_menu_value(num));
         window->refresh();
     } break;
+    case ControlType::Text:
+        break;
     }
 }
 
@@ -127,10 +209,85 @@ auto Callbacks::quit() -> void {
     }
 }
 
-auto Callbacks::refresh() -> void {
+auto Callbacks::notify_rows_changed() -> void {
+    if(window != nullptr) {
+        window->refresh();
+    }
+}
+
+auto Callbacks::notify_rows_replaced() -> void {
+    focus_control = nullptr;
+    control_rows.clear();
     for(auto i = 0u; i < rows.size(); i += 1) {
-        const auto y = i * row_height;
+        if(rows[i].get_index() == Row::index_of<ControlPtr>) {
+            control_rows[rows[i].as<ControlPtr>()] = i;
+        }
+    }
+    hud.reset_rows(control_rows);
+    if(window != nullptr) {
+        clamp_scroll();
+    }
+    notify_rows_changed();
+}
+
+auto Callbacks::notify_control_changed(const Control& control) -> void {
+    if(window == nullptr) {
+        return;
+    }
+    const auto p = control_rows.find(&control);
+    if(p == control_rows.end()) {
+        return;
+    }
+    const auto [first, last] = get_visible_rows();
+    if(p->second >= first && p->second < last) {
+        window->refresh();
+    }
+}
+
+auto Callbacks::notify_control_written(const Control& control, const uint64_t latency_ns) -> void {
+    if(!hud.is_enabled()) {
+        return;
+    }
+    hud.record_write(control_rows.contains(&control) ? &control : nullptr, latency_ns);
+    if(window != nullptr) {
+        window->refresh();
+    }
+}
+
+auto Callbacks::get_input_time() const -> uint64_t {
+    return hud.get_input_time();
+}
+
+auto Callbacks::get_text_cache() const -> const TextCache& {
+    return text_cache;
+}
+
+auto Callbacks::refresh() -> void {
+    // the whole buffer is repainted on each frame, so every visible row is drawn,
+    // but never the ones outside of the viewport
+    const auto frame_begin   = hud.now();
+    const auto [first, last] = get_visible_rows();
+    hud.refreshes += 1;
+    for(auto i = first; i < last; i += 1) {
+        const auto y = i * row_height - scroll;
+        if(!hud.is_enabled()) {
+            draw_row(rows[i], y);
+            continue;
+        }
+        const auto row_begin = hud.now();
         draw_row(rows[i], y);
+        hud.record_row(hud.now() - row_begin);
+        if(rows[i].get_index() == Row::index_of<ControlPtr>) {
+            draw_row_badge(*rows[i].as<ControlPtr>(), y);
+        }
+    }
+    if(hud.is_enabled()) {
+        hud.record_frame(hud.now() - frame_begin);
+        draw_hud();
+    }
+    if(!first_frame_drawn) {
+        first_frame_drawn = true;
+        startup::mark("first frame");
     }
 }
 
@@ -140,8 +297,22 @@ auto Callbacks::close() -> void {
 
 auto Callbacks::on_created(gawl::Window* /*window*/) -> coop::Async<bool> {
     constexpr auto error_value = false;
-    co_unwrap_v(fontpath, gawl::find_fontpath_from_name("Noto Sans CJK JP"));
-    font = gawl::TextRender({fontpath}, 32);
+    startup::mark("window created");
+    co_unwrap_v(path, co_await coop::run_blocking([this] { return fontpath.get(); }));
+    font = gawl::TextRender({path}, 32);
+    // sizes used by slider values and ranges
+    text_cache.warm_up(font, *window, {int((row_height - row_separetor_height) * 0.5), int((row_height - row_separetor_height) * 0.6)});
+    startup::mark("font loaded");
+    co_return true;
+}
+
+auto Callbacks::on_keycode(const uint32_t keycode, const gawl::ButtonState state) -> coop::Async<bool> {
+    if(keycode == KEY_LEFTSHIFT || keycode == KEY_RIGHTSHIFT) {
+        shift = state == gawl::ButtonState::Press || state == gawl::ButtonState::Repeat;
+    } else if(keycode == KEY_F3 && state == gawl::ButtonState::Press) {
+        hud.toggle();
+        window->refresh();
+    }
     co_return true;
 }
 
@@ -150,6 +321,7 @@ auto Callbacks::on_pointer(gawl::Point point) -> coop::Async<bool> {
     if(focus_control == nullptr) {
         co_return true;
     }
+    hud.mark_input();
     auto& ctrl = *focus_control;
     switch(focus_control->get_type()) {
     case ControlType::Int: {
@@ -157,7 +329,11 @@ auto Callbacks::on_pointer(gawl::Point point) -> coop::Async<bool> {
         const auto [min, max, step] = ctrl.get_range();
         const auto range            = (max - min + 1) / step;
         const auto value            = min + std::clamp(int32_t((point.x - slider_button_width / 2) / (width - slider_button_width) * range), 0, range - 1) * step;
-        callbacks->set_control_value(ctrl, value);
+        if(shift) {
+            callbacks->ramp_control_value(ctrl, value);
+        } else {
+            callbacks->set_control_value(ctrl, value);
+        }
         window->refresh();
     } break;
     default:
@@ -170,7 +346,8 @@ auto Callbacks::on_click(const uint32_t button, const gawl::ButtonState state) -
     if(button != BTN_LEFT) {
         co_return true;
     }
-    if(pointer.y >= rows.size() * row_height || state != gawl::ButtonState::Press) {
+    const auto row_y = pointer.y + scroll;
+    if(row_y >= rows.size() * row_height || state != gawl::ButtonState::Press) {
         if(focus_control != nullptr) {
             focus_control = nullptr;
             window->refresh();
@@ -179,13 +356,17 @@ auto Callbacks::on_click(const uint32_t button, const gawl::ButtonState state) -
         }
         co_return true;
     }
-    auto& row = rows[(pointer.y / row_height)];
+    hud.mark_input();
+    auto& row = rows[(row_y / row_height)];
     switch(row.get_index()) {
     case Row::index_of<ControlPtr>:
         proc_control_click(*row.as<ControlPtr>());
         break;
     case Row::index_of<Label>:
         break;
+    case Row::index_of<Tab>:
+        callbacks->select_tab(row.as<Tab>().index);
+        break;
     case Row::index_of<QuitButton>:
         quit();
         break;
@@ -193,8 +374,22 @@ auto Callbacks::on_click(const uint32_t button, const gawl::ButtonState state) -
     co_return true;
 }
 
+auto Callbacks::on_scroll(const gawl::WheelAxis axis, const double value) -> coop::Async<bool> {
+    if(axis != gawl::WheelAxis::Vertical) {
+        co_return true;
+    }
+    const auto prev = scroll;
+    scroll += value * scroll_speed;
+    clamp_scroll();
+    if(scroll != prev) {
+        window->refresh();
+    }
+    co_return true;
+}
+
 Callbacks::Callbacks(std::vector<Row>& rows, std::shared_ptr<UserCallbacks> callbacks)
-    : rows(rows),
+    : fontpath(std::async(std::launch::async, find_font)),
+      rows(rows),
       callbacks(callbacks) {
 }
 } // namespace vcw
@@ -1,8 +1,13 @@
 #pragma once
+#include <future>
+#include <unordered_map>
+
 #include <linux/input.h>
 
 #include "gawl/textrender.hpp"
 #include "gawl/window-no-touch-callbacks.hpp"
+#include "hud.hpp"
+#include "text-cache.hpp"
 
 #define CUTIL_NS vcw
 #include "util/variant.hpp"
@@ -13,6 +18,7 @@ enum class ControlType {
     Int,
     Bool,
     Menu,
+    Text, // read-only
 };
 
 struct ValueRange {
@@ -32,24 +38,40 @@ struct Control {
     virtual auto get_menu_size() -> size_t                        = 0;
     virtual auto get_menu_label(size_t index) -> std::string_view = 0;
     virtual auto get_menu_value(size_t index) -> int              = 0;
+    // for Text, valid until the next call
+    virtual auto get_text() -> std::string_view = 0;
 
     virtual ~Control() {};
 };
 
-using ControlPtr = std::unique_ptr<Control>;
+// owned by user
+using ControlPtr = Control*;
 
 struct Label {
     std::string text;
 };
 
+struct Tab {
+    std::string text;
+    size_t      index;
+    bool        selected;
+};
+
 struct QuitButton {
 };
 
-using Row = Variant<ControlPtr, Label, QuitButton>;
+using Row = Variant<ControlPtr, Label, Tab, QuitButton>;
 
 struct UserCallbacks {
     virtual auto set_control_value(Control& control, int value) -> void = 0;
 
+    // slider dragged with shift held, moves to value gradually
+    virtual auto ramp_control_value(Control& control, const int value) -> void {
+        set_control_value(control, value);
+    }
+
+    virtual auto select_tab(size_t /*index*/) -> void {}
+
     // return true to quit application
     virtual auto quit() -> bool {
         return true;
@@ -60,25 +82,56 @@ struct UserCallbacks {
 
 class Callbacks : public gawl::WindowNoTouchCallbacks {
   private:
+    // started on construction, so that it overlaps with connecting to the compositor
+    std::future<std::optional<std::string>> fontpath;
+
     gawl::TextRender               font;
+    TextCache                      text_cache;
     std::vector<Row>&              rows;
-    Control*                       focus_control = nullptr;
-    gawl::Point                    pointer       = {-1, -1};
+    Control*                       focus_control     = nullptr;
+    gawl::Point                    pointer           = {-1, -1};
+    bool                           shift             = false;
+    bool                           first_frame_drawn = false;
     std::shared_ptr<UserCallbacks> callbacks;
+    Hud                            hud; // toggled with F3
+    // rows are drawn with this offset, only rows in the viewport are drawn
+    double      scroll = 0;
+    ControlRows control_rows;
+
+    auto get_visible_rows() const -> std::pair<size_t, size_t>;
+    auto clamp_scroll() -> void;
 
     auto calc_button_center(Control& ctrl) const -> double;
     auto draw_control(Control& ctrl, double y) -> void;
+    auto draw_text(const gawl::Rectangle& rect, const gawl::Color& color, std::string_view text, int size, gawl::Align align) -> void;
     auto draw_label(std::string_view text, bool is_quit, double y) -> void;
+    auto draw_tab(const Tab& tab, double y) -> void;
     auto draw_row(Row& row, double y) -> void;
+    auto draw_row_badge(const Control& ctrl, double y) -> void;
+    auto draw_hud() -> void;
     auto proc_control_click(Control& ctrl) -> void;
     auto quit() -> void;
 
   public:
+    // call after modifying rows outside of the window callbacks
+    auto notify_rows_changed() -> void;
+    // same as above, but rows were rebuilt and old controls may be gone
+    auto notify_rows_replaced() -> void;
+    // redraws only if the row of control is in the viewport
+    auto notify_control_changed(const Control& control) -> void;
+    // the device finished writing a value of control, latency_ns after the input behind it
+    auto notify_control_written(const Control& control, uint64_t latency_ns) -> void;
+    // monotonic time of the input being handled, 0 while the hud is hidden
+    auto get_input_time() const -> uint64_t;
+    auto get_text_cache() const -> const TextCache&;
+
     auto refresh() -> void override;
     auto close() -> void override;
     auto on_created(gawl::Window* window) -> coop::Async<bool> override;
+    auto on_keycode(uint32_t keycode, gawl::ButtonState state) -> coop::Async<bool> override;
     auto on_pointer(gawl::Point point) -> coop::Async<bool> override;
     auto on_click(uint32_t button, gawl::ButtonState state) -> coop::Async<bool> override;
+    auto on_scroll(gawl::WheelAxis axis, double value) -> coop::Async<bool> override;
 
     Callbacks(std::vector<Row>& rows, std::shared_ptr<UserCallbacks> callbacks);
 };
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <iterator>
+#include <optional>
+
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "writer.hpp"
+
+namespace v4l2 {
+namespace {
+auto now_ns() -> uint64_t {
+    auto ts = timespec();
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+template <class Value>
+auto merge_value(std::vector<Value>& values, const Value value) -> void {
+    if(const auto p = std::ranges::find(values, value.id, &Value::id); p != values.end()) {
+        *p = value;
+    } else {
+        values.push_back(value);
+    }
+}
+} // namespace
+
+auto Writer::take_work(std::vector<Write>& batch, std::vector<ControlValue>& grouped) -> bool {
+    // a control is written by one worker at a time, so its values land in order
+    const auto is_free = [this](const uint32_t id) { return std::ranges::find(writing, id) == writing.end(); };
+    if(!pending_batch.empty() && std::ranges::all_of(pending_batch, is_free, &ControlValue::id)) {
+        std::swap(grouped, pending_batch);
+        std::ranges::transform(grouped, std::back_inserter(writing), &ControlValue::id);
+        return true;
+    }
+    if(const auto p = std::ranges::find_if(pending, is_free, &Write::id); p != pending.end()) {
+        batch.push_back(*p);
+        writing.push_back(p->id);
+        pending.erase(p);
+        return true;
+    }
+    return false;
+}
+
+auto Writer::worker_main() -> void {
+    auto batch   = std::vector<Write>();
+    auto grouped = std::vector<ControlValue>();
+    auto failed  = std::vector<Result>();
+    while(true) {
+        {
+            auto guard = std::unique_lock(lock);
+            cond.wait(guard, [&] { return !running || take_work(batch, grouped); });
+            if(!running) {
+                return;
+            }
+        }
+
+        // which values of a failed batch were applied is unknown, so all of them are read back
+        if(!grouped.empty() && !set_controls(fd, grouped).ok) {
+            for(const auto& value : grouped) {
+                const auto current = get_control(fd, value.id);
+                failed.push_back({value.id, current ? *current : value.value, false, 0, 0});
+            }
+        }
+
+        // a single control, other workers write the others meanwhile
+        auto result = std::optional<Result>();
+        if(!batch.empty()) {
+            const auto& value = batch.front();
+            result.emplace(Result{value.id, value.value, set_control(fd, value.id, value.value), value.input_ns, 0});
+            result->done_ns = value.input_ns != 0 ? now_ns() : 0;
+            if(!result->ok) {
+                if(const auto current = get_control(fd, value.id)) {
+                    result->value = *current;
+                }
+            }
+        }
+
+        {
+            auto guard = std::lock_guard(lock);
+            results.insert(results.end(), failed.begin(), failed.end());
+            // a newer value is going to overwrite this one anyway
+            if(result && (result->ok || std::ranges::find(pending, result->id, &Write::id) == pending.end())) {
+                results.push_back(*result);
+            }
+            for(const auto& value : grouped) {
+                std::erase(writing, value.id);
+            }
+            for(const auto& value : batch) {
+                std::erase(writing, value.id);
+            }
+        }
+        failed.clear();
+        grouped.clear();
+        batch.clear();
+        // values of the controls just released may be waiting
+        cond.notify_all();
+        eventfd_write(done_fd, 1);
+    }
+}
+
+auto Writer::write(const uint32_t id, const int32_t value, const uint64_t input_ns) -> void {
+    {
+        auto guard = std::lock_guard(lock);
+        merge_value(pending, Write{id, value, input_ns});
+    }
+    cond.notify_one();
+}
+
+auto Writer::write_batch(const std::span<const ControlValue> values) -> void {
+    {
+        auto guard = std::lock_guard(lock);
+        for(const auto value : values) {
+            merge_value(pending_batch, value);
+        }
+    }
+    cond.notify_one();
+}
+
+auto Writer::is_writing(const uint32_t id) -> bool {
+    auto guard = std::lock_guard(lock);
+    return std::ranges::find(writing, id) != writing.end() || std::ranges::find(pending, id, &Write::id) != pending.end() ||
+           std::ranges::find(pending_batch, id, &ControlValue::id) != pending_batch.end();
+}
+
+auto Writer::get_done_fd() const -> int {
+    return done_fd;
+}
+
+auto Writer::take_results() -> std::vector<Result> {
+    auto ret = std::vector<Result>();
+    eventfd_t count;
+    eventfd_read(done_fd, &count);
+
+    auto guard = std::lock_guard(lock);
+    std::swap(ret, results);
+    return ret;
+}
+
+Writer::Writer(const int fd)
+    : fd(fd),
+      done_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    for(auto i = 0; i < worker_count; i += 1) {
+        workers.emplace_back([this] { worker_main(); });
+    }
+}
+
+Writer::~Writer() {
+    {
+        auto guard = std::lock_guard(lock);
+        running    = false;
+    }
+    cond.notify_all();
+    for(auto& worker : workers) {
+        worker.join();
+    }
+    close(done_fd);
+}
+} // namespace v4l2
@@ -0,0 +1,62 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "v4l2.hpp"
+
+namespace v4l2 {
+// writes control values on worker threads
+// only the latest pending value of each control is written
+// controls are written in parallel, so a slow ioctl on one does not hold back the others,
+// but each control is written by one worker at a time
+// values given to write_batch() go out together in one ioctl
+class Writer {
+  public:
+    struct Result {
+        uint32_t id;
+        int32_t  value; // the value read back from the device if failed
+        bool     ok;
+        uint64_t input_ns; // given to write(), 0 for batches
+        uint64_t done_ns;  // CLOCK_MONOTONIC when the ioctl returned, 0 if input_ns is 0
+    };
+
+  private:
+    struct Write {
+        uint32_t id;
+        int32_t  value;
+        uint64_t input_ns;
+    };
+
+    constexpr static auto worker_count = 4;
+
+    int                       fd;
+    int                       done_fd;
+    std::mutex                lock;
+    std::condition_variable   cond;
+    std::vector<Write>        pending;
+    std::vector<ControlValue> pending_batch;
+    std::vector<uint32_t>     writing; // ids taken by workers
+    std::vector<Result>       results;
+    bool                      running = true;
+    std::vector<std::thread>  workers;
+
+    // moves the next batch, or the next value of a control no worker is writing, out of the pending ones
+    // called with lock held
+    auto take_work(std::vector<Write>& batch, std::vector<ControlValue>& grouped) -> bool;
+    auto worker_main() -> void;
+
+  public:
+    // input_ns is the CLOCK_MONOTONIC time of the input behind the value, to measure latency
+    auto write(uint32_t id, int32_t value, uint64_t input_ns = 0) -> void;
+    auto write_batch(std::span<const ControlValue> values) -> void;
+    // whether a value of id is pending or being written
+    auto is_writing(uint32_t id) -> bool;
+    // readable when take_results() has something to return
+    auto get_done_fd() const -> int;
+    auto take_results() -> std::vector<Result>;
+
+    Writer(int fd);
+    ~Writer();
+};
+} // namespace v4l2